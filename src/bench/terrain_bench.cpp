@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include "headers/terrain_squares.hpp"
+
+// Times the generation stages without a window:
+//
+//     terrain_bench [repetitions] [grid sizes...]
+//
+// Every timing is the fastest of its repetitions, as the slower runs only
+// measure whatever else the machine was doing.
+class TerrainBenchmark {
+public:
+    explicit TerrainBenchmark(unsigned int t_repetitions)
+        : repetitions(t_repetitions)
+    {
+    }
+
+    void run(const unsigned int grid_size) {
+        ScratchArena scratch;
+        auto cache = TerrainSquares::empty_cache(grid_size, scratch);
+        fill_maps(cache, grid_size);
+
+        // The vertex pass at every level, on its own
+        VertexData vertices(std::size_t(grid_size) * grid_size);
+        for(auto stride : cache.strides) {
+            const auto size = (grid_size - 1) / stride + 1;
+            const auto ms = fastest([&] {
+                TerrainSquares::generate_vertices(cache, grid_size, stride, settings, TerrainSquares::whole_map(size), CancelToken(), vertices.data());
+            });
+            std::cout << grid_size << " vertices stride " << stride << ": " << ms << " ms, "
+                      << ms * 1e6 / (double(size) * size) << " ns/vertex" << std::endl;
+        }
+
+        // Every level of a fresh map, noise included, as after a slider
+        // drag: once plain and once domain warped
+        std::cout << grid_size << " full generation: " << full_generation(grid_size, scratch, settings) << " ms" << std::endl;
+
+        auto warped = settings;
+        warped.warp_strength = 1.0f;
+        std::cout << grid_size << " full generation, warped: " << full_generation(grid_size, scratch, warped) << " ms" << std::endl;
+    }
+
+private:
+    unsigned int repetitions;
+    GenerationSettings settings;
+
+    double full_generation(const unsigned int grid_size, ScratchArena& scratch, const GenerationSettings& generation) const {
+        MeshUpdate update;
+        return fastest([&] {
+            OctaveLayerCache layers(TerrainSquares::default_layer_cache_budget);
+            auto fresh = TerrainSquares::empty_cache(grid_size, scratch);
+            fresh.layers = &layers;
+            TerrainSquares::generate_terrain_levels(fresh, grid_size, generation, CancelToken(), [&](const CancelToken&) {
+                return &update;
+            }, [](unsigned int) {});
+        });
+    }
+
+    template <typename F>
+    double fastest(F&& stage) const {
+        auto best = std::numeric_limits<double>::max();
+        for(unsigned int i = 0; i < repetitions; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            stage();
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    // Smooth fields standing in for the noise stages, so the vertex pass
+    // sees realistic heights and biomes without paying for them
+    static void fill_maps(GenerationCache& cache, const unsigned int grid_size) {
+        auto& height_map = cache.height_map;
+        auto& climate_map = cache.climate_map;
+        for(unsigned int y = 0; y < grid_size; y++) {
+            for(unsigned int x = 0; x < grid_size; x++) {
+                const auto i = height_map.heights.index(x, y);
+                const auto fx = x * 0.01f;
+                const auto fy = y * 0.013f;
+                height_map.heights[i] = std::sin(fx) * std::cos(fy) + 0.3f * std::sin(fx * 7.0f + fy * 3.0f);
+                height_map.slope_x[i] = std::cos(fx);
+                height_map.slope_y[i] = -std::sin(fy);
+                climate_map.temperature[i] = 0.5f + 0.4f * std::sin(fy * 0.3f);
+                climate_map.moisture[i] = 0.5f + 0.4f * std::cos(fx * 0.2f);
+            }
+        }
+        height_map.min_height = -1.3f;
+        height_map.max_height = 1.3f;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    const auto repetitions = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 3;
+
+    TerrainBenchmark benchmark(repetitions);
+    if(argc > 2) {
+        for(int i = 2; i < argc; i++) {
+            benchmark.run(std::atoi(argv[i]));
+        }
+    } else {
+        for(auto grid_size : { 1024u, 4096u, 8192u }) {
+            benchmark.run(grid_size);
+        }
+    }
+
+    return 0;
+}
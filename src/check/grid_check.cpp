@@ -0,0 +1,109 @@
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "headers/tiled_grid.hpp"
+
+// Checks TiledGrid's addressing at several tile sizes, including row-major,
+// and grid sizes that leave the far tiles partly padded:
+//
+//     grid_check
+//
+// Every sample has its own offset within the storage, from_linear and
+// to_linear round-trip, and for_each_run hands out the same offsets as
+// index. Exits with a non-zero status on the first failure of each case.
+template <unsigned int TileBits>
+class GridCheck {
+public:
+    static bool run(const unsigned int size) {
+        const auto passed = distinct_offsets(size) && round_trip(size) && runs(size);
+        std::cout << "tile bits " << TileBits << ", size " << size << ": " << (passed ? "ok" : "failed") << std::endl;
+        return passed;
+    }
+
+private:
+    using Grid = TiledGrid<int, TileBits>;
+
+    static bool distinct_offsets(const unsigned int size) {
+        const Grid grid(size);
+        std::vector<bool> used(Grid::storage_size(size));
+        for(unsigned int y = 0; y < size; y++) {
+            for(unsigned int x = 0; x < size; x++) {
+                const auto i = grid.index(x, y);
+                if(i >= used.size() || used[i]) {
+                    std::cout << "(" << x << ", " << y << ") is stored at offset " << i << ", which is out of range or taken" << std::endl;
+                    return false;
+                }
+                used[i] = true;
+            }
+        }
+        return true;
+    }
+
+    static bool round_trip(const unsigned int size) {
+        std::vector<int> linear(std::size_t(size) * size);
+        for(std::size_t i = 0; i < linear.size(); i++) {
+            linear[i] = int(i);
+        }
+
+        Grid grid(size);
+        grid.from_linear(linear.data());
+        for(unsigned int y = 0; y < size; y++) {
+            for(unsigned int x = 0; x < size; x++) {
+                if(grid(x, y) != int(std::size_t(y) * size + x)) {
+                    std::cout << "from_linear put " << grid(x, y) << " at (" << x << ", " << y << ")" << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        std::vector<int> back(linear.size(), -1);
+        grid.to_linear(back.data());
+        if(back != linear) {
+            std::cout << "to_linear does not give back the linear grid" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Walks from a few columns of every row at the steps the levels use,
+    // wrapping past the last column, and compares every run's offsets
+    static bool runs(const unsigned int size) {
+        const Grid grid(size);
+        for(unsigned int step : { 1u, 2u, 4u, 8u }) {
+            for(unsigned int y = 0; y < size; y++) {
+                for(unsigned int x : { 0u, size / 3, size - 1 }) {
+                    const auto count = (size - 1) / step + 1;
+                    unsigned int next = 0;
+                    auto passed = true;
+                    grid.for_each_run(x, y, step, count, [&](unsigned int i, std::size_t offset, unsigned int n) {
+                        passed = passed && i == next && n > 0;
+                        for(unsigned int j = 0; j < n; j++) {
+                            const auto column = (x + std::size_t(i + j) * step) % size;
+                            passed = passed && offset + std::size_t(j) * step == grid.index(column, y);
+                        }
+                        next = i + n;
+                    });
+
+                    if(!passed || next != count) {
+                        std::cout << "walk from (" << x << ", " << y << ") at step " << step << " does not match index" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+};
+
+int main()
+{
+    auto passed = true;
+    for(auto size : { 1u, 31u, 32u, 33u, 100u, 257u }) {
+        passed = GridCheck<5>::run(size) && passed;
+        passed = GridCheck<3>::run(size) && passed;
+        passed = GridCheck<0>::run(size) && passed;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "headers/noise_batch.hpp"
+#include "headers/noise_graphs.hpp"
+#include "headers/seeded_noise.hpp"
+
+// Runs every NoiseBatch entry point at each SIMD level the running CPU
+// supports and compares the output bit for bit:
+//
+//     noise_check
+//
+// With LatticeHash::SEEDED every level has to reproduce SeededNoise exactly.
+// The permutation kernels and the fused noise graphs have no scalar reference
+// of their own, so every level has to match the scalar level instead; a
+// compiler or flag change that lets one instruction set round differently
+// fails here. Exits with a non-zero status if any output differs.
+class NoiseCheck {
+public:
+    NoiseCheck() {
+        // Random positions on both sides of the origin, plus lattice points
+        // and their neighbouring floats, where the floor and fade are most
+        // likely to round differently
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-300.0f, 300.0f);
+        for(unsigned int i = 0; i < sample_count; i++) {
+            auto px = position(random);
+            auto py = position(random);
+            if(i % 8 == 1) {
+                px = std::floor(px);
+            } else if(i % 8 == 2) {
+                py = std::nextafter(std::floor(py), -1000.0f);
+            } else if(i % 8 == 3) {
+                px = std::nextafter(std::floor(px), 1000.0f);
+                py = std::floor(py);
+            }
+            x.push_back(px);
+            y.push_back(py);
+            z.push_back(px + py);
+        }
+    }
+
+    // True when every output at level matches
+    bool run(const SimdLevel level) {
+        NoiseBatch::set_level(level);
+        const auto before = failures;
+
+        for(auto seed : seeds) {
+            // Counts that are not a multiple of any register width, so the
+            // padded tail of each kernel is covered too
+            for(auto count : { sample_count, 13u, 1u }) {
+                compare(level, "seeded", evaluate_reference(seed, count), evaluate_batch(LatticeHash::SEEDED, seed, count));
+
+                NoiseBatch::set_level(SimdLevel::SCALAR);
+                const auto scalar = evaluate_batch(LatticeHash::PERMUTATION, seed, count);
+                const auto scalar_graphs = evaluate_graphs(LatticeHash::PERMUTATION, seed, count);
+                const auto scalar_seeded_graphs = evaluate_graphs(LatticeHash::SEEDED, seed, count);
+
+                NoiseBatch::set_level(level);
+                compare(level, "permutation", scalar, evaluate_batch(LatticeHash::PERMUTATION, seed, count));
+                compare(level, "permutation graph", scalar_graphs, evaluate_graphs(LatticeHash::PERMUTATION, seed, count));
+                compare(level, "seeded graph", scalar_seeded_graphs, evaluate_graphs(LatticeHash::SEEDED, seed, count));
+            }
+        }
+        return failures == before;
+    }
+
+private:
+    static constexpr unsigned int sample_count = 1003;
+    static constexpr std::int32_t seeds[] = { 0, 1337, -7 };
+    static constexpr unsigned int channels = 4;
+
+    // Every output array of every entry point, by name
+    using NoiseOutputs = std::vector<std::pair<std::string, std::vector<float>>>;
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    unsigned int failures = 0;
+
+    NoiseOutputs evaluate_batch(const LatticeHash hash, const std::int32_t seed, const unsigned int count) const {
+        std::vector<float> out(count);
+        std::vector<float> dx(count);
+        std::vector<float> dy(count);
+        std::vector<float> dz(count);
+        NoiseOutputs outputs;
+
+        NoiseBatch::perlin3(x.data(), y.data(), z.data(), out.data(), count, hash, seed);
+        outputs.emplace_back("perlin3", out);
+        NoiseBatch::perlin2(x.data(), y.data(), out.data(), count, hash, seed);
+        outputs.emplace_back("perlin2", out);
+        NoiseBatch::simplex2(x.data(), y.data(), out.data(), count, hash, seed);
+        outputs.emplace_back("simplex2", out);
+
+        NoiseBatch::perlin3_gradient(x.data(), y.data(), z.data(), out.data(), dx.data(), dy.data(), dz.data(), count, hash, seed);
+        outputs.emplace_back("perlin3_gradient value", out);
+        outputs.emplace_back("perlin3_gradient dx", dx);
+        outputs.emplace_back("perlin3_gradient dy", dy);
+        outputs.emplace_back("perlin3_gradient dz", dz);
+        NoiseBatch::perlin2_gradient(x.data(), y.data(), out.data(), dx.data(), dy.data(), count, hash, seed);
+        outputs.emplace_back("perlin2_gradient value", out);
+        outputs.emplace_back("perlin2_gradient dx", dx);
+        outputs.emplace_back("perlin2_gradient dy", dy);
+        NoiseBatch::simplex2_gradient(x.data(), y.data(), out.data(), dx.data(), dy.data(), count, hash, seed);
+        outputs.emplace_back("simplex2_gradient value", out);
+        outputs.emplace_back("simplex2_gradient dx", dx);
+        outputs.emplace_back("simplex2_gradient dy", dy);
+
+        std::vector<std::vector<float>> layers(channels, std::vector<float>(count));
+        float* layer_data[channels];
+        for(unsigned int c = 0; c < channels; c++) {
+            layer_data[c] = layers[c].data();
+        }
+        NoiseBatch::perlin2_channels(x.data(), y.data(), layer_data, channels, count, hash, seed);
+        for(unsigned int c = 0; c < channels; c++) {
+            outputs.emplace_back("perlin2_channels " + std::to_string(c), layers[c]);
+        }
+
+        return outputs;
+    }
+
+    // Every graph type the terrain compiles, with and without derivatives
+    NoiseOutputs evaluate_graphs(const LatticeHash hash, const std::int32_t seed, const unsigned int count) const {
+        NoiseOutputs outputs;
+        add_terrain_graphs<NoiseType::PERLIN_3D>(outputs, "perlin3", hash, seed, count);
+        add_terrain_graphs<NoiseType::PERLIN_2D>(outputs, "perlin2", hash, seed, count);
+        add_terrain_graphs<NoiseType::SIMPLEX_2D>(outputs, "simplex2", hash, seed, count);
+
+        TerrainWarpGraph warp;
+        warp.node.hash = hash;
+        warp.set_spectrum(2.0f, 0.5f);
+        add_graph(outputs, "warp", warp, seed, count);
+
+        return outputs;
+    }
+
+    // An unrolled fBm and one with a runtime octave count, set up the way
+    // TerrainSquares does apart from the per-octave offsets
+    template <NoiseType Type>
+    void add_terrain_graphs(NoiseOutputs& outputs, const std::string& name, const LatticeHash hash, const std::int32_t seed, const unsigned int count) const {
+        TerrainGraph<Type, 4> unrolled;
+        TerrainGraph<Type, 0> looped;
+        looped.octaves = 10;
+
+        const auto set_up = [&](auto& graph) {
+            graph.node.node.hash = hash;
+            graph.node.scale = 2.0f;
+            graph.node.bias = -1.0f;
+            graph.set_spectrum(2.0f, 0.5f);
+            for(auto i = 0; i < graph.max_octaves; i++) {
+                graph.offset_x[i] = i * 13.7f;
+                graph.offset_y[i] = i * -5.3f;
+            }
+        };
+        set_up(unrolled);
+        set_up(looped);
+
+        add_graph(outputs, name + " fbm 4", unrolled, seed, count);
+        add_graph(outputs, name + " fbm 10", looped, seed, count);
+    }
+
+    template <typename Graph>
+    void add_graph(NoiseOutputs& outputs, const std::string& name, const Graph& graph, const std::int32_t seed, const unsigned int count) const {
+        std::vector<float> out(count);
+        std::vector<float> dx(count);
+        std::vector<float> dy(count);
+
+        NoiseGraph::evaluate(graph, x.data(), y.data(), out.data(), count, seed);
+        outputs.emplace_back(name, out);
+        NoiseGraph::evaluate_gradient(graph, x.data(), y.data(), out.data(), dx.data(), dy.data(), count, seed);
+        outputs.emplace_back(name + " gradient value", out);
+        outputs.emplace_back(name + " gradient dx", dx);
+        outputs.emplace_back(name + " gradient dy", dy);
+    }
+
+    // Same layout as evaluate_batch, sample by sample from SeededNoise
+    NoiseOutputs evaluate_reference(const std::int32_t seed, const unsigned int count) const {
+        std::vector<SeededNoise::Gradient3> perlin3(count);
+        std::vector<SeededNoise::Gradient2> perlin2(count);
+        std::vector<SeededNoise::Gradient2> simplex2(count);
+        std::vector<std::vector<float>> layers(channels, std::vector<float>(count));
+        for(unsigned int i = 0; i < count; i++) {
+            perlin3[i] = SeededNoise::perlin3_gradient(seed, x[i], y[i], z[i]);
+            perlin2[i] = SeededNoise::perlin2_gradient(seed, x[i], y[i]);
+            simplex2[i] = SeededNoise::simplex2_gradient(seed, x[i], y[i]);
+            for(unsigned int c = 0; c < channels; c++) {
+                layers[c][i] = SeededNoise::perlin2_channel(seed, x[i], y[i], c);
+            }
+        }
+
+        const auto field = [](const auto& samples, const auto get) {
+            std::vector<float> values;
+            for(const auto& sample : samples) {
+                values.push_back(get(sample));
+            }
+            return values;
+        };
+        using G2 = const SeededNoise::Gradient2&;
+        using G3 = const SeededNoise::Gradient3&;
+
+        NoiseOutputs outputs;
+        outputs.emplace_back("perlin3", field(perlin3, [](G3 g) { return g.value; }));
+        outputs.emplace_back("perlin2", field(perlin2, [](G2 g) { return g.value; }));
+        outputs.emplace_back("simplex2", field(simplex2, [](G2 g) { return g.value; }));
+        outputs.emplace_back("perlin3_gradient value", field(perlin3, [](G3 g) { return g.value; }));
+        outputs.emplace_back("perlin3_gradient dx", field(perlin3, [](G3 g) { return g.dx; }));
+        outputs.emplace_back("perlin3_gradient dy", field(perlin3, [](G3 g) { return g.dy; }));
+        outputs.emplace_back("perlin3_gradient dz", field(perlin3, [](G3 g) { return g.dz; }));
+        outputs.emplace_back("perlin2_gradient value", field(perlin2, [](G2 g) { return g.value; }));
+        outputs.emplace_back("perlin2_gradient dx", field(perlin2, [](G2 g) { return g.dx; }));
+        outputs.emplace_back("perlin2_gradient dy", field(perlin2, [](G2 g) { return g.dy; }));
+        outputs.emplace_back("simplex2_gradient value", field(simplex2, [](G2 g) { return g.value; }));
+        outputs.emplace_back("simplex2_gradient dx", field(simplex2, [](G2 g) { return g.dx; }));
+        outputs.emplace_back("simplex2_gradient dy", field(simplex2, [](G2 g) { return g.dy; }));
+        for(unsigned int c = 0; c < channels; c++) {
+            outputs.emplace_back("perlin2_channels " + std::to_string(c), layers[c]);
+        }
+
+        return outputs;
+    }
+
+    // Reports the first differing sample of each output
+    void compare(const SimdLevel level, const std::string& what, const NoiseOutputs& expected, const NoiseOutputs& actual) {
+        for(std::size_t k = 0; k < expected.size(); k++) {
+            const auto& name = expected[k].first;
+            const auto& want = expected[k].second;
+            const auto& got = actual[k].second;
+
+            for(std::size_t i = 0; i < want.size(); i++) {
+                if(std::memcmp(&want[i], &got[i], sizeof(float)) != 0) {
+                    std::cout << NoiseBatch::level_name(level) << " " << what << " " << name
+                              << " differs at sample " << i << " of " << want.size()
+                              << " (" << x[i] << ", " << y[i] << "): "
+                              << std::hexfloat << got[i] << " instead of " << want[i]
+                              << std::defaultfloat << std::endl;
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+int main()
+{
+    NoiseCheck check;
+    auto passed = true;
+    for(auto level : { SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+        if(level > NoiseBatch::detected_level()) {
+            std::cout << NoiseBatch::level_name(level) << ": not supported, skipped" << std::endl;
+            continue;
+        }
+        const auto identical = check.run(level);
+        std::cout << NoiseBatch::level_name(level) << ": " << (identical ? "identical" : "differs") << std::endl;
+        passed = passed && identical;
+    }
+
+    return passed ? 0 : 1;
+}
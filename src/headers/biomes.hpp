@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+enum class Biome {
+    DEEP_WATER,
+    WATER,
+    BEACH,
+    TUNDRA,
+    TAIGA,
+    GRASSLAND,
+    FOREST,
+    DENSE_FOREST,
+    DESERT,
+    SAVANNA,
+    RAINFOREST,
+    ROCK,
+    MOUNTAIN,
+    SNOW
+};
+
+// Whittaker-style lookup: height picks water, beach and mountain bands as
+// the old colour ramp did, temperature and moisture pick the lowland biome
+class Biomes {
+public:
+    // Biomes there are, numbered as in the enum
+    static constexpr std::size_t count = static_cast<std::size_t>(Biome::SNOW) + 1;
+
+    static Biome classify(float height, float temperature, float moisture) {
+        if(height <= 0.3f) {
+            return Biome::DEEP_WATER;
+        }
+        if(height <= 0.4f) {
+            return Biome::WATER;
+        }
+        if(height <= 0.45f) {
+            return temperature < 0.2f ? Biome::TUNDRA : Biome::BEACH;
+        }
+        if(height > 0.9f || (height > 0.6f && temperature < 0.15f)) {
+            return Biome::SNOW;
+        }
+        if(height > 0.7f) {
+            return Biome::MOUNTAIN;
+        }
+        if(height > 0.6f) {
+            return Biome::ROCK;
+        }
+
+        if(temperature < 0.3f) {
+            return moisture < 0.5f ? Biome::TUNDRA : Biome::TAIGA;
+        }
+        if(temperature < 0.65f) {
+            if(moisture < 0.33f) {
+                return Biome::GRASSLAND;
+            }
+            return moisture < 0.66f ? Biome::FOREST : Biome::DENSE_FOREST;
+        }
+        if(moisture < 0.33f) {
+            return Biome::DESERT;
+        }
+        return moisture < 0.66f ? Biome::SAVANNA : Biome::RAINFOREST;
+    }
+
+    static glm::vec3 color(Biome biome) {
+        switch(biome) {
+            case Biome::DEEP_WATER:
+                return glm::vec3(0.12f, 0.29f, 0.72f);
+            case Biome::WATER:
+                return glm::vec3(0.13f, 0.30f, 0.76f);
+            case Biome::BEACH:
+                return glm::vec3(0.77f, 0.80f, 0.28f);
+            case Biome::TUNDRA:
+                return glm::vec3(0.55f, 0.58f, 0.50f);
+            case Biome::TAIGA:
+                return glm::vec3(0.18f, 0.32f, 0.24f);
+            case Biome::GRASSLAND:
+                return glm::vec3(0.20f, 0.55f, 0.0f);
+            case Biome::FOREST:
+                return glm::vec3(0.14f, 0.36f, 0.0f);
+            case Biome::DENSE_FOREST:
+                return glm::vec3(0.08f, 0.27f, 0.04f);
+            case Biome::DESERT:
+                return glm::vec3(0.84f, 0.73f, 0.45f);
+            case Biome::SAVANNA:
+                return glm::vec3(0.60f, 0.58f, 0.22f);
+            case Biome::RAINFOREST:
+                return glm::vec3(0.02f, 0.40f, 0.10f);
+            case Biome::ROCK:
+                return glm::vec3(0.30f, 0.20f, 0.17f);
+            case Biome::MOUNTAIN:
+                return glm::vec3(0.23f, 0.18f, 0.16f);
+            default:
+                return glm::vec3(1.0f, 1.0f, 1.0f);
+        }
+    }
+
+    // Colour of every biome by number, for shaders that look them up
+    static std::array<glm::vec3, count> palette() {
+        std::array<glm::vec3, count> colors;
+        for(std::size_t i = 0; i < count; i++) {
+            colors[i] = color(static_cast<Biome>(i));
+        }
+        return colors;
+    }
+
+    // Biome at the middle of every cell of a cells^3 grid over height,
+    // temperature and moisture in [0, 1], height varying fastest, for
+    // shaders that classify samples themselves
+    static std::vector<std::uint8_t> lookup_table(std::size_t cells) {
+        std::vector<std::uint8_t> table(cells * cells * cells);
+        const auto middle = [cells](std::size_t cell) {
+            return (cell + 0.5f) / cells;
+        };
+        for(std::size_t moisture = 0; moisture < cells; moisture++) {
+            for(std::size_t temperature = 0; temperature < cells; temperature++) {
+                for(std::size_t height = 0; height < cells; height++) {
+                    const auto biome = classify(middle(height), middle(temperature), middle(moisture));
+                    table[(moisture * cells + temperature) * cells + height] = static_cast<std::uint8_t>(biome);
+                }
+            }
+        }
+        return table;
+    }
+};
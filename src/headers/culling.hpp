@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+struct CullStats {
+    std::size_t tested;
+    std::size_t frustum_culled;
+    std::size_t occluded;
+};
+
+// Axis aligned box in model space
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// The six clip planes of a projection * view * model matrix, pointing
+// inwards
+class Frustum {
+public:
+    explicit Frustum(const glm::mat4& clip) {
+        // Rows of the matrix; glm stores columns
+        const auto row = [&](int i) {
+            return glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        };
+
+        planes[0] = row(3) + row(0);
+        planes[1] = row(3) - row(0);
+        planes[2] = row(3) + row(1);
+        planes[3] = row(3) - row(1);
+        planes[4] = row(3) + row(2);
+        planes[5] = row(3) - row(2);
+    }
+
+    // False only when the box is entirely outside one of the planes
+    bool intersects(const BoundingBox& box) const {
+        for (const auto& plane : planes) {
+            // Corner furthest along the plane's normal
+            const auto corner = glm::vec3(
+                plane.x >= 0.0f ? box.max.x : box.min.x,
+                plane.y >= 0.0f ? box.max.y : box.min.y,
+                plane.z >= 0.0f ? box.max.z : box.min.z);
+
+            if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    std::array<glm::vec4, 6> planes;
+};
+
+// Highest elevation, as the tangent of the angle above the eye, that the
+// terrain blocks so far in each direction around the eye. Boxes standing on
+// the terrain are added and tested front to back: a box that is fully
+// behind the others and stays below their horizon in every direction it
+// spans can't be seen.
+//
+// A box of terrain blocks every ray crossing its footprint that passes below
+// its lowest point wherever it crosses, which is what it adds. Its
+// footprint only covers its directions completely between the first and
+// last bin, so the bins at its edges are left alone.
+class HorizonBuffer {
+public:
+    static constexpr unsigned int bins = 512;
+
+    // Starts over from an eye at position, clearing every direction
+    void reset(const glm::vec3& position) {
+        eye = position;
+        std::fill(horizon.begin(), horizon.end(), -std::numeric_limits<float>::infinity());
+        pending.clear();
+    }
+
+    // Ground distances from the eye to the nearest and furthest point of a
+    // box's footprint
+    float near_distance(const BoundingBox& box) const {
+        const auto dx = std::max({ box.min.x - eye.x, 0.0f, eye.x - box.max.x });
+        const auto dz = std::max({ box.min.z - eye.z, 0.0f, eye.z - box.max.z });
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    float far_distance(const BoundingBox& box) const {
+        const auto dx = std::max(std::abs(box.min.x - eye.x), std::abs(box.max.x - eye.x));
+        const auto dz = std::max(std::abs(box.min.z - eye.z), std::abs(box.max.z - eye.z));
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    // Boxes have to be tested in order of near_distance. Occluders take
+    // effect once the tested boxes are entirely beyond them.
+    bool occluded(const BoundingBox& box) {
+        const auto near = near_distance(box);
+        commit(near);
+        if (near <= 0.0f) {
+            return false;
+        }
+
+        const auto span = bin_span(box);
+        const auto rise = box.max.y - eye.y;
+        const auto elevation = rise / (rise >= 0.0f ? near : far_distance(box));
+        for (auto bin = span.first; bin <= span.last; bin++) {
+            if (horizon[wrap(bin)] <= elevation) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void add_occluder(const BoundingBox& box) {
+        const auto near = near_distance(box);
+        if (near <= 0.0f) {
+            return;
+        }
+
+        const auto far = far_distance(box);
+        const auto rise = box.min.y - eye.y;
+        const auto occluder = Occluder { bin_span(box), rise / (rise >= 0.0f ? far : near), far };
+
+        // The horizon only rises, so an occluder below it already never will
+        auto raises = false;
+        for (auto bin = occluder.span.first + 1; bin < occluder.span.last && !raises; bin++) {
+            raises = horizon[wrap(bin)] < occluder.elevation;
+        }
+        if (!raises) {
+            return;
+        }
+
+        pending.push_back(occluder);
+        std::push_heap(pending.begin(), pending.end(), further);
+    }
+
+private:
+    // Bins first to last, which may run past the end and wrap around
+    struct BinSpan {
+        int first;
+        int last;
+    };
+
+    struct Occluder {
+        BinSpan span;
+        float elevation;
+        float far;
+    };
+
+    static unsigned int wrap(const int bin) {
+        return static_cast<unsigned int>((bin % static_cast<int>(bins) + static_cast<int>(bins)) % static_cast<int>(bins));
+    }
+
+    // Direction of an offset as a turn from 0 to 4 that grows with the
+    // angle, without the cost of atan2. Bins cover slightly different
+    // angles, which doesn't matter as long as they all use it.
+    static float turn(const float x, const float z) {
+        if (z >= 0.0f) {
+            return x >= 0.0f ? z / (x + z) : 1.0f - x / (z - x);
+        }
+        return x < 0.0f ? 2.0f - z / (-x - z) : 3.0f + x / (x - z);
+    }
+
+    // Bins the footprint's directions fall in. The eye is outside the
+    // footprint, so its directions are within half a turn of the centre's.
+    BinSpan bin_span(const BoundingBox& box) const {
+        const auto centre = turn(0.5f * (box.min.x + box.max.x) - eye.x, 0.5f * (box.min.z + box.max.z) - eye.z);
+        auto low = 0.0f;
+        auto high = 0.0f;
+        for (const auto x : { box.min.x, box.max.x }) {
+            for (const auto z : { box.min.z, box.max.z }) {
+                auto offset = turn(x - eye.x, z - eye.z) - centre;
+                offset -= 4.0f * std::round(offset / 4.0f);
+                low = std::min(low, offset);
+                high = std::max(high, offset);
+            }
+        }
+
+        const auto scale = bins / 4.0f;
+        return BinSpan {
+            static_cast<int>(std::floor((centre + low) * scale)),
+            static_cast<int>(std::floor((centre + high) * scale))
+        };
+    }
+
+    // Orders pending as a heap with the nearest occluder on top
+    static bool further(const Occluder& a, const Occluder& b) {
+        return a.far > b.far;
+    }
+
+    // Raises the horizon by the occluders entirely nearer than distance
+    void commit(const float distance) {
+        while (!pending.empty() && pending.front().far <= distance) {
+            const auto& occluder = pending.front();
+            for (auto bin = occluder.span.first + 1; bin < occluder.span.last; bin++) {
+                auto& height = horizon[wrap(bin)];
+                height = std::max(height, occluder.elevation);
+            }
+
+            std::pop_heap(pending.begin(), pending.end(), further);
+            pending.pop_back();
+        }
+    }
+
+    glm::vec3 eye;
+    std::array<float, bins> horizon;
+    std::vector<Occluder> pending;
+};
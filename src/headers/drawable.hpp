@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <variant>
 #include <vector>
 
@@ -27,9 +29,57 @@ if(GLenum err = glGetError()) {                                             \
 
 using Indices = std::vector<unsigned int>;
 
+// glBufferStorage comes with GL 4.4 or ARB_buffer_storage, past the 3.3 core
+// profile the loader covers, so it is looked up on its own and left null
+// where the context doesn't have it
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+using BufferStorageProc = void (APIENTRYP)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+inline BufferStorageProc gl_buffer_storage = nullptr;
+
+// Call once the context is current
+inline void load_buffer_storage(GLADloadproc load) {
+    auto supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for(GLint i = 0; i < extensions && !supported; i++) {
+        const auto name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        supported = name && std::strcmp(name, "GL_ARB_buffer_storage") == 0;
+    }
+    gl_buffer_storage = supported ? reinterpret_cast<BufferStorageProc>(load("glBufferStorage")) : nullptr;
+}
+
 enum class VertexDataType {
     FLOAT = GL_FLOAT,
-    UNSIGNED_INT = GL_UNSIGNED_INT
+    UNSIGNED_INT = GL_UNSIGNED_INT,
+    UNSIGNED_SHORT = GL_UNSIGNED_SHORT,
+    SHORT = GL_SHORT,
+    UNSIGNED_BYTE = GL_UNSIGNED_BYTE
+};
+
+// Bytes taken by one value of the type
+inline std::size_t type_size(const VertexDataType type) {
+    switch(type) {
+        case VertexDataType::UNSIGNED_SHORT:
+        case VertexDataType::SHORT:
+            return 2;
+        case VertexDataType::UNSIGNED_BYTE:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+// How the shader sees an attribute: as floats converted straight from the
+// values, as floats scaled from the integer type's range to [0, 1] or
+// [-1, 1], or as the integers themselves
+enum class AttributeMode {
+    FLOAT,
+    NORMALIZED,
+    INTEGER
 };
 
 struct VertexArrayObject {
@@ -84,21 +134,19 @@ struct VertexBufferObject {
     }
 
     ~VertexBufferObject() {
-        glGenBuffers(1, &vbo);
-    }
-
-    void enable_attribute_pointer(std::size_t index, std::size_t size, VertexDataType t_type, std::size_t stride, std::size_t offset) {
-        auto width = 0;
-        switch(t_type) {
-            case VertexDataType::FLOAT:
-            case VertexDataType::UNSIGNED_INT:
-            {
-                width = 4;
-            }
-            break;
-        }
+        glDeleteBuffers(1, &vbo);
+    }
+
+    // Stride and offset are counted in values of t_type
+    void enable_attribute_pointer(std::size_t index, std::size_t size, VertexDataType t_type, std::size_t stride, std::size_t offset, AttributeMode mode = AttributeMode::FLOAT) {
+        const auto width = type_size(t_type);
 
-        GL_CHECK(glVertexAttribPointer(index, size, static_cast<GLenum>(t_type), GL_FALSE, stride * width, reinterpret_cast<void *>(offset * width)));
+        if(mode == AttributeMode::INTEGER) {
+            GL_CHECK(glVertexAttribIPointer(index, size, static_cast<GLenum>(t_type), stride * width, reinterpret_cast<void *>(offset * width)));
+        } else {
+            const auto normalized = mode == AttributeMode::NORMALIZED ? GL_TRUE : GL_FALSE;
+            GL_CHECK(glVertexAttribPointer(index, size, static_cast<GLenum>(t_type), normalized, stride * width, reinterpret_cast<void *>(offset * width)));
+        }
         GL_CHECK(glEnableVertexAttribArray(index));
     }
 
@@ -116,13 +164,47 @@ struct VertexBufferObject {
         GL_CHECK(glBufferData(static_cast<GLenum>(type), Size * sizeof(data[0]), &data[0], static_cast<GLenum>(draw_type)));
     }
 
+    // Replaces the buffer's contents, and its size with data's. The old
+    // storage is orphaned rather than overwritten, so draws still reading it
+    // finish undisturbed while the new one is mapped without waiting on
+    // them.
     template<typename Type>
     void update_data(const std::vector<Type> &data) const {
-        void *ptr = GL_CHECK(glMapBuffer(static_cast<GLenum>(type), GL_WRITE_ONLY));
-        memcpy(ptr, &data[0], sizeof(Type) * data.size());
+        const auto bytes = sizeof(Type) * data.size();
+        GL_CHECK(glBufferData(static_cast<GLenum>(type), bytes, nullptr, GL_DYNAMIC_DRAW));
+        void *ptr = GL_CHECK(glMapBufferRange(static_cast<GLenum>(type), 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        memcpy(ptr, &data[0], bytes);
         GL_CHECK(glUnmapBuffer(static_cast<GLenum>(type)));
     }
 
+    // Overwrites count elements starting at element first, leaving the rest
+    // of the buffer as it is
+    template<typename Type>
+    void update_data(const Type *data, std::size_t first, std::size_t count) const {
+        GL_CHECK(glBufferSubData(static_cast<GLenum>(type), sizeof(Type) * first, sizeof(Type) * count, data));
+    }
+
+    // Sends indices as index_type, narrowing them through narrowed when
+    // they are 16 bits wide
+    void send_indices(const Indices &data, const VertexDataType index_type, const VertexDrawType draw_type, std::vector<std::uint16_t> &narrowed) const {
+        if(index_type == VertexDataType::UNSIGNED_SHORT) {
+            narrowed.assign(data.begin(), data.end());
+            send_data(narrowed, draw_type);
+        } else {
+            send_data(data, draw_type);
+        }
+    }
+
+    // Overwrites indices starting at index first the same way
+    void update_indices(const Indices &data, std::size_t first, const VertexDataType index_type, std::vector<std::uint16_t> &narrowed) const {
+        if(index_type == VertexDataType::UNSIGNED_SHORT) {
+            narrowed.assign(data.begin(), data.end());
+            update_data(narrowed.data(), first, narrowed.size());
+        } else {
+            update_data(data.data(), first, data.size());
+        }
+    }
+
     void unbind() const {
         GL_CHECK(glBindBuffer(static_cast<GLenum>(type), 0));
     }
@@ -131,6 +213,198 @@ struct VertexBufferObject {
     const VertexBufferType type;
 };
 
+// How the regions of a StreamingBuffer are written
+enum class StreamMode {
+    // Mapped for each write without synchronising, as the region is known
+    // to be done with
+    UNSYNCHRONIZED,
+    // Mapped once for the buffer's lifetime, coherently, so any thread can
+    // write through the mapping. Needs gl_buffer_storage.
+    PERSISTENT
+};
+
+// A buffer the CPU keeps rewriting while the GPU draws from it, split into a
+// ring of equal regions: while one is drawn, the next is written. Retiring a
+// region fences the commands issued so far, and it is only available again
+// once they are done, so writes neither wait on the GPU nor reach frames
+// still in flight. Empty regions allocate nothing.
+class StreamingBuffer {
+public:
+    StreamingBuffer(const VertexBufferType t_type, const std::size_t t_region_bytes, const std::size_t regions, const StreamMode t_mode)
+        : vbo(t_type),
+          mode(t_mode),
+          region_bytes(t_region_bytes),
+          fences(regions, nullptr),
+          mapping(nullptr)
+    {
+        const auto bytes = region_bytes * regions;
+        if(bytes == 0) {
+            return;
+        }
+
+        const auto target = static_cast<GLenum>(vbo.type);
+        vbo.bind();
+        if(mode == StreamMode::PERSISTENT) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GL_CHECK(gl_buffer_storage(target, bytes, nullptr, flags));
+            void *ptr = GL_CHECK(glMapBufferRange(target, 0, bytes, flags));
+            mapping = static_cast<std::uint8_t *>(ptr);
+        } else {
+            GL_CHECK(glBufferData(target, bytes, nullptr, GL_STREAM_DRAW));
+        }
+        vbo.unbind();
+    }
+
+    StreamingBuffer(StreamingBuffer&& other)
+        : vbo(std::move(other.vbo)),
+          mode(other.mode),
+          region_bytes(other.region_bytes),
+          fences(std::move(other.fences)),
+          mapping(other.mapping)
+    {
+        other.fences.clear();
+        other.mapping = nullptr;
+    }
+
+    // Deleting the buffer unmaps it
+    ~StreamingBuffer() {
+        for(auto fence : fences) {
+            glDeleteSync(fence);
+        }
+    }
+
+    // Persistent where the context allows it
+    static StreamMode preferred_mode() {
+        return gl_buffer_storage ? StreamMode::PERSISTENT : StreamMode::UNSYNCHRONIZED;
+    }
+
+    // Marks the region as read by every command issued so far
+    void retire(const std::size_t region) {
+        glDeleteSync(fences[region]);
+        fences[region] = GL_CHECK(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    }
+
+    // True once the GPU is done with the commands the region was last
+    // retired after. Never waits for them.
+    bool available(const std::size_t region) {
+        if(!fences[region]) {
+            return true;
+        }
+
+        const auto status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(status == GL_WAIT_FAILED) {
+            throw std::runtime_error("Waiting on a streaming buffer fence failed");
+        }
+        if(status == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+
+        glDeleteSync(fences[region]);
+        fences[region] = nullptr;
+        return true;
+    }
+
+    // Where bytes [first, first + count) of an available region are
+    // written. Persistent buffers hand out their mapping, which stays valid
+    // and may be written from any thread. Otherwise the buffer, which must
+    // be bound, is mapped unsynchronised until unmap, dropping the range's
+    // old contents when invalidate is set.
+    void *map(const std::size_t region, const std::size_t first, const std::size_t count, const bool invalidate) {
+        const auto offset = region * region_bytes + first;
+        if(mode == StreamMode::PERSISTENT) {
+            return mapping + offset;
+        }
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | (invalidate ? GL_MAP_INVALIDATE_RANGE_BIT : 0);
+        void *ptr = GL_CHECK(glMapBufferRange(static_cast<GLenum>(vbo.type), offset, count, flags));
+        return ptr;
+    }
+
+    void unmap() const {
+        if(mode != StreamMode::PERSISTENT) {
+            GL_CHECK(glUnmapBuffer(static_cast<GLenum>(vbo.type)));
+        }
+    }
+
+    bool persistent() const {
+        return mode == StreamMode::PERSISTENT;
+    }
+
+    VertexBufferObject vbo;
+
+private:
+    StreamMode mode;
+    std::size_t region_bytes;
+    std::vector<GLsync> fences;
+    std::uint8_t *mapping;
+};
+
+enum class TextureType {
+    TEXTURE_2D = GL_TEXTURE_2D,
+    TEXTURE_3D = GL_TEXTURE_3D
+};
+
+// Unsigned integer texels, which shaders read exactly with texelFetch from
+// a usampler
+enum class TexelFormat {
+    R8UI = GL_R8UI,
+    RGBA8UI = GL_RGBA8UI
+};
+
+struct TextureObject {
+    using TextureInner = GLuint;
+
+    explicit TextureObject(const TextureType t_type) : texture(0u), type(t_type) {
+        GL_CHECK(glGenTextures(1, &texture));
+    }
+
+    explicit TextureObject(TextureObject&& other)
+        : texture(other.texture), type(other.type)
+    {
+        other.texture = 0;
+    }
+
+    ~TextureObject() {
+        glDeleteTextures(1, &texture);
+    }
+
+    void bind(const unsigned int unit) const {
+        GL_CHECK(glActiveTexture(GL_TEXTURE0 + unit));
+        GL_CHECK(glBindTexture(static_cast<GLenum>(type), texture));
+    }
+
+    // Allocates width x height x depth texels, depth 1 for a 2D texture, and
+    // fills them from tightly packed data. Integer textures are never
+    // filtered, and without mipmaps they are only complete when sampled
+    // nearest.
+    void send_data(const TexelFormat format, std::size_t width, std::size_t height, std::size_t depth, const void *data) const {
+        const auto target = static_cast<GLenum>(type);
+        GL_CHECK(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        GL_CHECK(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        GL_CHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+        if(type == TextureType::TEXTURE_3D) {
+            GL_CHECK(glTexImage3D(target, 0, static_cast<GLint>(format), width, height, depth, 0, pixel_format(format), GL_UNSIGNED_BYTE, data));
+        } else {
+            GL_CHECK(glTexImage2D(target, 0, static_cast<GLint>(format), width, height, 0, pixel_format(format), GL_UNSIGNED_BYTE, data));
+        }
+    }
+
+    // Overwrites the width x height texels of a 2D texture from x, y on,
+    // leaving the rest as they are
+    void update_data(const TexelFormat format, std::size_t x, std::size_t y, std::size_t width, std::size_t height, const void *data) const {
+        GL_CHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+        GL_CHECK(glTexSubImage2D(static_cast<GLenum>(type), 0, x, y, width, height, pixel_format(format), GL_UNSIGNED_BYTE, data));
+    }
+
+    TextureInner texture;
+    const TextureType type;
+
+private:
+    static GLenum pixel_format(const TexelFormat format) {
+        return format == TexelFormat::R8UI ? GL_RED_INTEGER : GL_RGBA_INTEGER;
+    }
+};
+
 enum class VertexPrimitive {
     TRIANGLES = GL_TRIANGLES,
     TRIANGLE_STRIP = GL_TRIANGLE_STRIP,
@@ -147,10 +421,21 @@ struct DrawElements {
     VertexPrimitive primitive;
     std::size_t count;
     VertexDataType type;
-    Indices& indices;
+    // Index to start drawing from in the element buffer
+    std::size_t first;
+};
+
+// Several runs of the element buffer in one call, given by their index
+// counts and byte offsets. Strips in either draw end at the largest value
+// of the index type.
+struct MultiDrawElements {
+    VertexPrimitive primitive;
+    const std::vector<GLsizei>& counts;
+    VertexDataType type;
+    const std::vector<const void *>& offsets;
 };
 
-using DrawType = std::variant<DrawArrays, DrawElements>;
+using DrawType = std::variant<DrawArrays, DrawElements, MultiDrawElements>;
 
 template <typename Child>
 class Drawable {
@@ -187,18 +472,37 @@ public:
             );
         } else if(std::holds_alternative<DrawElements>(draw_type)) {
             auto draw_elements = std::get_if<DrawElements>(&draw_type);
+            restart_strips(draw_elements->primitive, draw_elements->type);
             GL_CHECK(
                 glDrawElements(
                     static_cast<GLenum>(draw_elements->primitive), 
                     draw_elements->count, 
                     static_cast<GLenum>(draw_elements->type), 
-                    nullptr//&draw_elements->indices[0]
+                    reinterpret_cast<void *>(draw_elements->first * type_size(draw_elements->type))
+                )
+            );
+        } else if(std::holds_alternative<MultiDrawElements>(draw_type)) {
+            auto multi_draw = std::get_if<MultiDrawElements>(&draw_type);
+            restart_strips(multi_draw->primitive, multi_draw->type);
+            GL_CHECK(
+                glMultiDrawElements(
+                    static_cast<GLenum>(multi_draw->primitive),
+                    multi_draw->counts.data(),
+                    static_cast<GLenum>(multi_draw->type),
+                    multi_draw->offsets.data(),
+                    static_cast<GLsizei>(multi_draw->counts.size())
                 )
             );
         }
     }
 
 protected:
+    static void restart_strips(const VertexPrimitive primitive, const VertexDataType type) {
+        if(primitive == VertexPrimitive::TRIANGLE_STRIP) {
+            GL_CHECK(glPrimitiveRestartIndex(type == VertexDataType::UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF));
+        }
+    }
+
     explicit Drawable(VertexArrayObject&& t_vao) : vao(std::move(t_vao)) {}
     virtual ~Drawable() {}
 
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "drawable.hpp"
+
+// How the cells of a grid are turned into indices
+struct IndexOptions {
+    // TRIANGLES, or TRIANGLE_STRIP with a strip per row of cells
+    VertexPrimitive primitive;
+    // Cells in bands of band_cells columns rather than in whole rows
+    bool cache_order;
+};
+
+// Element buffer layout of a rows x columns grid of cells, two triangles a
+// cell split along the same diagonal whatever the primitive. Cells are laid
+// out band by band, row by row within a band; without cache order the one
+// band is as wide as the grid, which is plain row by row order.
+//
+// Every vertex is shared by two rows of cells, and only gets shaded once
+// when the row before's vertices are still in the post-transform cache.
+// A band keeps 2 (band_cells + 1) vertices in flight, within even a 16
+// entry cache, so about 0.6 vertices are shaded per triangle where whole
+// rows of a large grid shade almost every vertex twice, at 1.0.
+//
+// A strip takes a row of a band in 2 (w + 1) indices and a restart where a
+// list of triangles takes 6 w.
+class GridIndices {
+public:
+    GridIndices(const unsigned int t_rows, const unsigned int t_columns, const IndexOptions t_options, const std::size_t t_first = 0)
+        : rows(t_rows),
+          columns(t_columns),
+          options(t_options),
+          first(t_first),
+          band_width(std::max(1u, options.cache_order ? std::min(band_cells, t_columns) : t_columns))
+    {}
+
+    // Appends the indices, where cell x, z joins vertex(x, z),
+    // vertex(x + 1, z), vertex(x, z + 1) and vertex(x + 1, z + 1)
+    template <typename F>
+    void append(Indices& indices, F&& vertex) const {
+        indices.reserve(indices.size() + count());
+        for (unsigned int band = 0; band < bands(); band++) {
+            const auto [z0, z1] = band_columns(band);
+            for (unsigned int x = 0; x < rows; x++) {
+                if (options.primitive == VertexPrimitive::TRIANGLE_STRIP) {
+                    for (auto z = z0; z <= z1; z++) {
+                        indices.push_back(vertex(x + 1, z));
+                        indices.push_back(vertex(x, z));
+                    }
+                    indices.push_back(restart_index);
+                    continue;
+                }
+
+                for (auto z = z0; z < z1; z++) {
+                    const auto v00 = vertex(x, z);
+                    const auto v01 = vertex(x, z + 1);
+                    const auto v10 = vertex(x + 1, z);
+                    const auto v11 = vertex(x + 1, z + 1);
+
+                    indices.push_back(v00);
+                    indices.push_back(v11);
+                    indices.push_back(v10);
+
+                    indices.push_back(v11);
+                    indices.push_back(v00);
+                    indices.push_back(v01);
+                }
+            }
+        }
+    }
+
+    unsigned int bands() const {
+        return (columns + band_width - 1) / band_width;
+    }
+
+    // First and last column of cells of a band
+    std::pair<unsigned int, unsigned int> band_columns(const unsigned int band) const {
+        return { band * band_width, std::min((band + 1) * band_width, columns) };
+    }
+
+    // Indices that draw cells z0 to z1 of row x, which must lie in one
+    // band. Ones reaching the band's end take in its restart, so a row
+    // running on into the next one is a single span.
+    std::pair<std::size_t, std::size_t> span(const unsigned int x, const unsigned int z0, const unsigned int z1) const {
+        const auto band = z0 / band_width;
+        const auto [band_z0, band_z1] = band_columns(band);
+        const auto row = first + band_offset(band) + std::size_t(x) * row_count(band_z1 - band_z0);
+        if (options.primitive == VertexPrimitive::TRIANGLE_STRIP) {
+            const auto end = z1 == band_z1 ? row + row_count(band_z1 - band_z0) : row + 2 * (z1 - band_z0 + 1);
+            return { row + 2 * (z0 - band_z0), end };
+        }
+        return { row + 6 * (z0 - band_z0), row + 6 * (z1 - band_z0) };
+    }
+
+    // Where the grid's indices start in the element buffer
+    std::size_t first_index() const {
+        return first;
+    }
+
+    // Indices of the whole grid
+    std::size_t count() const {
+        return band_offset(bands());
+    }
+
+    VertexPrimitive primitive() const {
+        return options.primitive;
+    }
+
+    // Narrowest index type for a mesh of vertex_count vertices, 16 bits
+    // wide unless a vertex would need the restart index or more
+    static VertexDataType index_type(const std::size_t vertex_count, const VertexPrimitive primitive) {
+        const std::size_t short_vertices = primitive == VertexPrimitive::TRIANGLE_STRIP ? 0xFFFF : 0x10000;
+        return vertex_count <= short_vertices ? VertexDataType::UNSIGNED_SHORT : VertexDataType::UNSIGNED_INT;
+    }
+
+    // Strips in cache order, the fewest indices and vertices shaded
+    static constexpr IndexOptions default_options { VertexPrimitive::TRIANGLE_STRIP, true };
+
+    static constexpr unsigned int band_cells = 6;
+    // Ends a strip, narrowed along with the rest to 0xFFFF for 16 bit indices
+    static constexpr unsigned int restart_index = 0xFFFFFFFF;
+
+private:
+    // Indices of a row of a band width cells wide
+    std::size_t row_count(const unsigned int width) const {
+        return options.primitive == VertexPrimitive::TRIANGLE_STRIP ? 2 * (width + 1) + 1 : 6 * width;
+    }
+
+    std::size_t band_offset(const unsigned int band) const {
+        const auto full = std::min(band, columns / band_width);
+        auto offset = std::size_t(full) * rows * row_count(band_width);
+        if (band > full) {
+            offset += std::size_t(rows) * row_count(columns - full * band_width);
+        }
+        return offset;
+    }
+
+    unsigned int rows;
+    unsigned int columns;
+    IndexOptions options;
+    std::size_t first;
+    unsigned int band_width;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class SimdLevel {
+    SCALAR,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+enum class NoiseType {
+    // Original 3D improved noise sampled on the (x, y, x + y) plane; kept so
+    // existing seeds reproduce the same terrain
+    PERLIN_3D,
+    PERLIN_2D,
+    SIMPLEX_2D
+};
+
+enum class LatticeHash {
+    // Ken Perlin's 256-entry permutation table. Repeats every 256 cells and
+    // ignores the seed; the terrain seed only offsets the sample positions
+    PERMUTATION,
+    // Integer hash of the cell coordinates mixed with the seed. Needs no table
+    // lookups and does not tile, and every seed is an independent field
+    SEEDED
+};
+
+// Evaluates noise over whole rows or tiles of samples at once. The kernels are
+// picked at runtime from the best instruction set the CPU supports; the
+// scalar fallback runs the exact same float operations, so every level
+// produces bit-identical output.
+class NoiseBatch {
+public:
+    // Best level supported by both this build and the running CPU
+    static SimdLevel detected_level();
+    static SimdLevel active_level();
+
+    // Forces a lower level, e.g. to compare against the scalar fallback.
+    // Levels above detected_level() are clamped.
+    static void set_level(SimdLevel level);
+
+    static std::string_view level_name(SimdLevel level);
+
+    // With LatticeHash::PERMUTATION, out[i] = Perlin::noise(x[i], y[i], z[i])
+    // for i < count to within float rounding of the reference implementation.
+    // With LatticeHash::SEEDED the output matches SeededNoise exactly.
+    static void perlin3(const float* x, const float* y, const float* z, float* out, std::size_t count, LatticeHash hash = LatticeHash::PERMUTATION, std::int32_t seed = 0);
+
+    // Native 2D gradient noise, 4 lattice corners per sample
+    static void perlin2(const float* x, const float* y, float* out, std::size_t count, LatticeHash hash = LatticeHash::PERMUTATION, std::int32_t seed = 0);
+
+    // 2D simplex noise, 3 lattice corners per sample
+    static void simplex2(const float* x, const float* y, float* out, std::size_t count, LatticeHash hash = LatticeHash::PERMUTATION, std::int32_t seed = 0);
+
+    // Same values as the functions above, plus the analytic partial
+    // derivatives of the noise along each input axis
+    static void perlin3_gradient(const float* x, const float* y, const float* z, float* out, float* out_dx, float* out_dy, float* out_dz, std::size_t count, LatticeHash hash = LatticeHash::PERMUTATION, std::int32_t seed = 0);
+    static void perlin2_gradient(const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, LatticeHash hash = LatticeHash::PERMUTATION, std::int32_t seed = 0);
+    static void simplex2_gradient(const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, LatticeHash hash = LatticeHash::PERMUTATION, std::int32_t seed = 0);
+
+    // Several decorrelated perlin2 fields at once, written to out[c] for each
+    // channel c (at most 4). The lattice lookups are shared between channels,
+    // so each extra channel costs a fraction of another perlin2 call. Channel
+    // 0 matches perlin2.
+    static void perlin2_channels(const float* x, const float* y, float* const* out, std::size_t channels, std::size_t count, LatticeHash hash = LatticeHash::PERMUTATION, std::int32_t seed = 0);
+};
@@ -0,0 +1,425 @@
+#pragma once
+
+// Composable noise graphs. A graph is a tree of node types that is fixed at
+// compile time, e.g. Fbm<Ridged<Source<NoiseType::SIMPLEX_2D>>, 6>, while the
+// node parameters are plain members set at runtime. Each node evaluates one
+// register of samples, so the whole tree inlines into a single loop over the
+// input and no intermediate layer is ever written out to memory.
+//
+// Every node returns its value together with the partial derivatives along
+// its two inputs, and the combinators carry them through with the chain rule.
+// A graph has to be listed in NoiseGraphTable (noise_graphs.hpp) to be
+// compiled for each instruction set.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+#include "noise_batch.hpp"
+#include "noise_kernels.hpp"
+
+// Unrolled fBm kernels are compiled for octave counts up to this, larger
+// counts use the Octaves = 0 variant with a runtime loop
+constexpr int max_unrolled_octaves = 8;
+
+template <typename Graph>
+struct NoiseGraphKernels {
+    // Value-only kernels are called with null derivative outputs
+    using Func = void (*)(const Graph& graph, const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, std::int32_t seed);
+
+    Func value;
+    Func gradient;
+};
+
+template <typename... Graphs>
+struct NoiseGraphTableOf {
+    std::tuple<NoiseGraphKernels<Graphs>...> kernels;
+
+    template <typename Graph>
+    const NoiseGraphKernels<Graph>& get() const {
+        return std::get<NoiseGraphKernels<Graph>>(kernels);
+    }
+};
+
+namespace
+{
+    template <typename F, int... I>
+    void unroll(F&& f, std::integer_sequence<int, I...>)
+    {
+        (f(I), ...);
+    }
+
+    template <typename L>
+    typename L::Float negate(const typename L::Float v)
+    {
+        return L::sub(L::splat(0.0f), v);
+    }
+
+    template <typename L, typename H, bool Derivatives>
+    Gradient2<L> sample_noise(const NoiseType type, const typename L::Float x, const typename L::Float y, const H& hash)
+    {
+        switch(type) {
+            case NoiseType::PERLIN_2D:
+                return perlin2_sample<L, H, Derivatives>(x, y, hash);
+            case NoiseType::SIMPLEX_2D:
+                return simplex2_sample<L, H, Derivatives>(x, y, hash);
+            default: {
+                // z follows x + y, so it feeds into both derivatives
+                const auto sample = perlin3_sample<L, H, Derivatives>(x, y, L::add(x, y), hash);
+
+                Gradient2<L> result = {};
+                result.value = sample.value;
+                if constexpr(Derivatives) {
+                    result.dx = L::add(sample.dx, sample.dz);
+                    result.dy = L::add(sample.dy, sample.dz);
+                }
+                return result;
+            }
+        }
+    }
+}
+
+// Leaf node: one layer of noise in roughly [-1, 1]
+template <NoiseType Type>
+struct Source
+{
+    LatticeHash hash = LatticeHash::PERMUTATION;
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        if(hash == LatticeHash::SEEDED) {
+            return sample_noise<L, SeededHash<L>, Derivatives>(Type, x, y, SeededHash<L>(seed));
+        }
+        return sample_noise<L, PermutationHash<L>, Derivatives>(Type, x, y, PermutationHash<L>(seed));
+    }
+};
+
+// Sums octaves of node, octave i sampled at input * frequency[i] + offset[i]
+// and weighted by amplitude[i]. Each octave is handed seed + i.
+template <typename Node, int Octaves = 0>
+struct Fbm
+{
+    // With Octaves = 0 the count is read from octaves at runtime
+    static constexpr int max_octaves = Octaves > 0 ? Octaves : 16;
+
+    Node node;
+    int octaves = Octaves;
+    std::array<float, max_octaves> frequency = {};
+    std::array<float, max_octaves> amplitude = {};
+    std::array<float, max_octaves> offset_x = {};
+    std::array<float, max_octaves> offset_y = {};
+
+    // Geometric spectrum starting from frequency and amplitude 1
+    void set_spectrum(const float lacunarity, const float gain)
+    {
+        auto f = 1.0f;
+        auto a = 1.0f;
+        for(auto i = 0; i < max_octaves; i++) {
+            frequency[i] = f;
+            amplitude[i] = a;
+            a *= gain;
+            f *= lacunarity;
+        }
+    }
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        Gradient2<L> sum = { L::splat(0.0f), L::splat(0.0f), L::splat(0.0f) };
+
+        const auto octave = [&](const int i) {
+            const auto f = L::splat(frequency[i]);
+            const auto a = L::splat(amplitude[i]);
+            const auto layer = node.template eval<L, Derivatives>(
+                L::add(L::mul(x, f), L::splat(offset_x[i])),
+                L::add(L::mul(y, f), L::splat(offset_y[i])),
+                seed + i);
+
+            sum.value = L::add(sum.value, L::mul(layer.value, a));
+            if constexpr(Derivatives) {
+                const auto scale = L::mul(a, f);
+                sum.dx = L::add(sum.dx, L::mul(layer.dx, scale));
+                sum.dy = L::add(sum.dy, L::mul(layer.dy, scale));
+            }
+        };
+
+        if constexpr(Octaves > 0) {
+            unroll(octave, std::make_integer_sequence<int, Octaves>());
+        } else {
+            for(auto i = 0; i < octaves && i < max_octaves; i++) {
+                octave(i);
+            }
+        }
+
+        return sum;
+    }
+};
+
+// value * scale + bias
+template <typename Node>
+struct Remap
+{
+    Node node;
+    float scale = 1.0f;
+    float bias = 0.0f;
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        auto result = node.template eval<L, Derivatives>(x, y, seed);
+        const auto s = L::splat(scale);
+
+        result.value = L::add(L::mul(result.value, s), L::splat(bias));
+        if constexpr(Derivatives) {
+            result.dx = L::mul(result.dx, s);
+            result.dy = L::mul(result.dy, s);
+        }
+        return result;
+    }
+};
+
+// 1 - |value|: sharp crests where the node crosses zero
+template <typename Node>
+struct Ridged
+{
+    Node node;
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        auto result = node.template eval<L, Derivatives>(x, y, seed);
+        const auto negative = L::less(result.value, L::splat(0.0f));
+
+        result.value = L::sub(L::splat(1.0f), L::max(result.value, negate<L>(result.value)));
+        if constexpr(Derivatives) {
+            result.dx = L::select(negative, result.dx, negate<L>(result.dx));
+            result.dy = L::select(negative, result.dy, negate<L>(result.dy));
+        }
+        return result;
+    }
+};
+
+// |value| * 2 - 1: rounded hills with creases in the valleys
+template <typename Node>
+struct Billow
+{
+    Node node;
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        auto result = node.template eval<L, Derivatives>(x, y, seed);
+        const auto negative = L::less(result.value, L::splat(0.0f));
+        const auto two = L::splat(2.0f);
+
+        result.value = L::sub(L::mul(L::max(result.value, negate<L>(result.value)), two), L::splat(1.0f));
+        if constexpr(Derivatives) {
+            result.dx = L::mul(L::select(negative, negate<L>(result.dx), result.dx), two);
+            result.dy = L::mul(L::select(negative, negate<L>(result.dy), result.dy), two);
+        }
+        return result;
+    }
+};
+
+// Piecewise linear remapping through control points sorted by input, held
+// flat outside the first and last point
+template <typename Node>
+struct Curve
+{
+    static constexpr int max_points = 8;
+
+    Node node;
+    int points = 0;
+    std::array<float, max_points> input = {};
+    std::array<float, max_points> output = {};
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        auto result = node.template eval<L, Derivatives>(x, y, seed);
+        if(points == 0) {
+            return result;
+        }
+
+        const auto v = result.value;
+        auto value = L::splat(output[0]);
+        auto slope = L::splat(0.0f);
+
+        // later segments overwrite earlier ones once v has passed their start
+        for(auto i = 1; i < points; i++) {
+            const auto start = L::splat(input[i - 1]);
+            const auto segment_slope = L::splat((output[i] - output[i - 1]) / (input[i] - input[i - 1]));
+            const auto segment = L::add(L::splat(output[i - 1]), L::mul(L::sub(v, start), segment_slope));
+            const auto before = L::less(v, start);
+
+            value = L::select(before, value, segment);
+            slope = L::select(before, slope, segment_slope);
+        }
+
+        const auto past_end = L::less(L::splat(input[points - 1]), v);
+        result.value = L::select(past_end, L::splat(output[points - 1]), value);
+
+        if constexpr(Derivatives) {
+            slope = L::select(past_end, L::splat(0.0f), slope);
+            result.dx = L::mul(result.dx, slope);
+            result.dy = L::mul(result.dy, slope);
+        }
+        return result;
+    }
+};
+
+// Samples node at input + strength * (warp_x, warp_y), where the two
+// displacement fields are warp evaluated with different seeds and offsets
+template <typename Warp, typename Node>
+struct DomainWarp
+{
+    Warp warp;
+    Node node;
+    float strength = 1.0f;
+
+    // Keeps the two displacements apart when the lattice ignores the seed
+    static constexpr float offset = 17.31f;
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        const auto s = L::splat(strength);
+        const auto o = L::splat(offset);
+
+        const auto warp_x = warp.template eval<L, Derivatives>(x, y, seed + 1);
+        const auto warp_y = warp.template eval<L, Derivatives>(L::add(x, o), L::add(y, o), seed + 2);
+
+        auto result = node.template eval<L, Derivatives>(
+            L::add(x, L::mul(s, warp_x.value)),
+            L::add(y, L::mul(s, warp_y.value)),
+            seed);
+
+        if constexpr(Derivatives) {
+            // gradient of the node times the Jacobian of the warped position
+            const auto one = L::splat(1.0f);
+            const auto dx = L::add(
+                L::mul(result.dx, L::add(one, L::mul(s, warp_x.dx))),
+                L::mul(result.dy, L::mul(s, warp_y.dx)));
+            const auto dy = L::add(
+                L::mul(result.dx, L::mul(s, warp_x.dy)),
+                L::mul(result.dy, L::add(one, L::mul(s, warp_y.dy))));
+
+            result.dx = dx;
+            result.dy = dy;
+        }
+        return result;
+    }
+};
+
+// Linear blend from a to b, driven by mask. The mask is mapped from [-1, 1]
+// to [0, 1] and steepened by sharpness before it is clamped.
+template <typename A, typename B, typename Mask>
+struct Blend
+{
+    A a;
+    B b;
+    Mask mask;
+    float sharpness = 1.0f;
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> eval(const typename L::Float x, const typename L::Float y, const std::int32_t seed) const
+    {
+        const auto zero = L::splat(0.0f);
+        const auto one = L::splat(1.0f);
+        const auto k = L::splat(0.5f * sharpness);
+
+        const auto from = a.template eval<L, Derivatives>(x, y, seed);
+        const auto to = b.template eval<L, Derivatives>(x, y, seed + 1);
+        const auto m = mask.template eval<L, Derivatives>(x, y, seed + 2);
+
+        const auto raw = L::add(L::mul(m.value, k), L::splat(0.5f));
+        const auto t = L::min(L::max(raw, zero), one);
+        const auto difference = L::sub(to.value, from.value);
+
+        Gradient2<L> result = {};
+        result.value = L::add(from.value, L::mul(t, difference));
+
+        if constexpr(Derivatives) {
+            const auto clamped = L::mask_or(L::less(raw, zero), L::less(one, raw));
+            const auto axis = [&](const typename L::Float d_from, const typename L::Float d_to, const typename L::Float d_mask) {
+                const auto dt = L::select(clamped, zero, L::mul(d_mask, k));
+                return L::add(L::add(d_from, L::mul(t, L::sub(d_to, d_from))), L::mul(dt, difference));
+            };
+
+            result.dx = axis(from.dx, to.dx, m.dx);
+            result.dy = axis(from.dy, to.dy, m.dy);
+        }
+        return result;
+    }
+};
+
+namespace
+{
+    template <typename L, typename Graph, bool Derivatives>
+    void graph_batch(const Graph& graph, const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, std::int32_t seed)
+    {
+        std::size_t i = 0;
+        for(; i + L::width <= count; i += L::width) {
+            const auto result = graph.template eval<L, Derivatives>(L::load(x + i), L::load(y + i), seed);
+            L::store(out + i, result.value);
+            if constexpr(Derivatives) {
+                L::store(out_dx + i, result.dx);
+                L::store(out_dy + i, result.dy);
+            }
+        }
+
+        // same padded tail as batch2
+        if(i < count) {
+            float tail_x[L::width] = {};
+            float tail_y[L::width] = {};
+            float tail_out[L::width];
+            float tail_dx[L::width];
+            float tail_dy[L::width];
+
+            const auto remaining = count - i;
+            for(std::size_t j = 0; j < remaining; j++) {
+                tail_x[j] = x[i + j];
+                tail_y[j] = y[i + j];
+            }
+
+            const auto result = graph.template eval<L, Derivatives>(L::load(tail_x), L::load(tail_y), seed);
+            L::store(tail_out, result.value);
+            L::store(tail_dx, result.dx);
+            L::store(tail_dy, result.dy);
+
+            for(std::size_t j = 0; j < remaining; j++) {
+                out[i + j] = tail_out[j];
+                if constexpr(Derivatives) {
+                    out_dx[i + j] = tail_dx[j];
+                    out_dy[i + j] = tail_dy[j];
+                }
+            }
+        }
+    }
+
+    template <typename L, typename Table>
+    struct NoiseGraphTableBuilder;
+
+    template <typename L, typename... Graphs>
+    struct NoiseGraphTableBuilder<L, NoiseGraphTableOf<Graphs...>>
+    {
+        static NoiseGraphTableOf<Graphs...> make()
+        {
+            return NoiseGraphTableOf<Graphs...> {
+                std::make_tuple(NoiseGraphKernels<Graphs> {
+                    graph_batch<L, Graphs, false>,
+                    graph_batch<L, Graphs, true>,
+                }...),
+            };
+        }
+    };
+
+    template <typename L, typename Table>
+    Table make_noise_graph_table()
+    {
+        return NoiseGraphTableBuilder<L, Table>::make();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// The noise graphs compiled into every instruction set. A graph type has to
+// appear in NoiseGraphTable before NoiseGraph can evaluate it.
+
+#include <type_traits>
+#include <utility>
+
+#include "noise_graph.hpp"
+
+// Octave noise used by TerrainSquares. Remap reproduces the original
+// noise * 2 - 1 scaling of each octave.
+template <NoiseType Type, int Octaves>
+using TerrainGraph = Fbm<Remap<Source<Type>>, Octaves>;
+
+// Low-frequency field that domain warps the terrain
+using TerrainWarpGraph = Fbm<Source<NoiseType::SIMPLEX_2D>, 2>;
+
+template <typename Sequence>
+struct TerrainGraphList;
+
+template <int... Octaves>
+struct TerrainGraphList<std::integer_sequence<int, Octaves...>> {
+    using Table = NoiseGraphTableOf<
+        TerrainGraph<NoiseType::PERLIN_3D, Octaves>...,
+        TerrainGraph<NoiseType::PERLIN_2D, Octaves>...,
+        TerrainGraph<NoiseType::SIMPLEX_2D, Octaves>...,
+        TerrainWarpGraph>;
+};
+
+using NoiseGraphTable = TerrainGraphList<std::make_integer_sequence<int, max_unrolled_octaves + 1>>::Table;
+
+const NoiseGraphTable& scalar_noise_graphs();
+const NoiseGraphTable& sse42_noise_graphs();
+const NoiseGraphTable& avx2_noise_graphs();
+const NoiseGraphTable& avx512_noise_graphs();
+
+// Table for NoiseBatch::active_level()
+const NoiseGraphTable& active_noise_graphs();
+
+// Calls f(std::integral_constant<int, N>()) with N = octaves when an unrolled
+// kernel exists for that count, and with N = 0 otherwise
+template <int N = 1, typename F>
+void with_unrolled_octaves(const int octaves, F&& f) {
+    if constexpr(N > max_unrolled_octaves) {
+        f(std::integral_constant<int, 0>());
+    } else if(octaves == N) {
+        f(std::integral_constant<int, N>());
+    } else {
+        with_unrolled_octaves<N + 1>(octaves, std::forward<F>(f));
+    }
+}
+
+class NoiseGraph {
+public:
+    template <typename Graph>
+    static void evaluate(const Graph& graph, const float* x, const float* y, float* out, std::size_t count, std::int32_t seed = 0) {
+        active_noise_graphs().get<Graph>().value(graph, x, y, out, nullptr, nullptr, count, seed);
+    }
+
+    // Also writes the partial derivatives of the graph along x and y
+    template <typename Graph>
+    static void evaluate_gradient(const Graph& graph, const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, std::int32_t seed = 0) {
+        active_noise_graphs().get<Graph>().gradient(graph, x, y, out, out_dx, out_dy, count, seed);
+    }
+};
@@ -0,0 +1,719 @@
+#pragma once
+
+// Batch noise kernels shared by every instruction set. This header is
+// included by noise_batch.cpp (scalar) and by each noise_<isa>.cpp, which are
+// compiled with their own -m flags. Everything templated lives in an anonymous
+// namespace so the per-ISA instantiations can never be merged across
+// translation units by the linker.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "noise_lanes.hpp"
+#include "perlin.hpp"
+#include "seeded_noise.hpp"
+
+// Value-only entry points are called with null derivative outputs
+using NoiseBatch2Func = void (*)(const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, std::int32_t seed);
+using NoiseBatch3Func = void (*)(const float* x, const float* y, const float* z, float* out, float* out_dx, float* out_dy, float* out_dz, std::size_t count, std::int32_t seed);
+
+// Most channels a single multi-channel call evaluates
+constexpr std::size_t max_noise_channels = 4;
+
+// out[c] receives channel c, for c < channels
+using NoiseChannelsFunc = void (*)(const float* x, const float* y, float* const* out, std::size_t channels, std::size_t count, std::int32_t seed);
+
+// One entry per batch entry point in NoiseBatch
+struct NoiseKernelSet {
+    NoiseBatch3Func perlin3;
+    NoiseBatch2Func perlin2;
+    NoiseBatch2Func simplex2;
+    NoiseBatch3Func perlin3_gradient;
+    NoiseBatch2Func perlin2_gradient;
+    NoiseBatch2Func simplex2_gradient;
+    NoiseChannelsFunc perlin2_channels;
+};
+
+struct NoiseKernelTable {
+    NoiseKernelSet permutation;
+    NoiseKernelSet seeded;
+};
+
+const NoiseKernelTable& scalar_noise_kernels();
+const NoiseKernelTable& sse42_noise_kernels();
+const NoiseKernelTable& avx2_noise_kernels();
+const NoiseKernelTable& avx512_noise_kernels();
+
+namespace
+{
+    // perm widened to 32 bits so it can be used as a gather table
+    struct WidePermutation
+    {
+        constexpr WidePermutation() : values()
+        {
+            for(auto i = 0; i < 512; i++) {
+                values[i] = perm[i];
+            }
+        }
+
+        alignas(64) std::int32_t values[512];
+    };
+
+    static constexpr WidePermutation perm32;
+
+    template <typename L>
+    struct Corners2
+    {
+        typename L::Int h00, h10, h01, h11;
+    };
+
+    template <typename L>
+    struct Corners3
+    {
+        typename L::Int h000, h100, h010, h110, h001, h101, h011, h111;
+    };
+
+    // Lattice hashing through Ken Perlin's permutation table. The lattice
+    // repeats every 256 cells and is the same for every seed.
+    template <typename L>
+    struct PermutationHash
+    {
+        explicit PermutationHash(std::int32_t) {}
+
+        static typename L::Int point2(const typename L::Int ix, const typename L::Int iy)
+        {
+            const auto mask = L::splat_int(255);
+            const auto* table = perm32.values;
+            return L::gather(table, L::add_int(L::and_int(ix, mask), L::gather(table, L::and_int(iy, mask))));
+        }
+
+        static Corners2<L> cell2(const typename L::Int ix, const typename L::Int iy)
+        {
+            const auto* table = perm32.values;
+            const auto one = L::splat_int(1);
+            const auto mask = L::splat_int(255);
+            const auto unit_x = L::and_int(ix, mask);
+            const auto unit_y = L::and_int(iy, mask);
+
+            const auto a = L::add_int(L::gather(table, unit_x), unit_y);
+            const auto b = L::add_int(L::gather(table, L::add_int(unit_x, one)), unit_y);
+
+            return Corners2<L> {
+                L::gather(table, a),
+                L::gather(table, b),
+                L::gather(table, L::add_int(a, one)),
+                L::gather(table, L::add_int(b, one)),
+            };
+        }
+
+        static Corners3<L> cell3(const typename L::Int ix, const typename L::Int iy, const typename L::Int iz)
+        {
+            const auto* table = perm32.values;
+            const auto one = L::splat_int(1);
+            const auto mask = L::splat_int(255);
+            const auto unit_x = L::and_int(ix, mask);
+            const auto unit_y = L::and_int(iy, mask);
+            const auto unit_z = L::and_int(iz, mask);
+
+            // hash coordinates of the 8 cube coordinates
+            const auto a = L::add_int(L::gather(table, unit_x), unit_y);
+            const auto aa = L::add_int(L::gather(table, a), unit_z);
+            const auto ab = L::add_int(L::gather(table, L::add_int(a, one)), unit_z);
+            const auto b = L::add_int(L::gather(table, L::add_int(unit_x, one)), unit_y);
+            const auto ba = L::add_int(L::gather(table, b), unit_z);
+            const auto bb = L::add_int(L::gather(table, L::add_int(b, one)), unit_z);
+
+            return Corners3<L> {
+                L::gather(table, aa),
+                L::gather(table, ba),
+                L::gather(table, ab),
+                L::gather(table, bb),
+                L::gather(table, L::add_int(aa, one)),
+                L::gather(table, L::add_int(ba, one)),
+                L::gather(table, L::add_int(ab, one)),
+                L::gather(table, L::add_int(bb, one)),
+            };
+        }
+    };
+
+    // Arithmetic lattice hashing keyed by the seed. Only multiplies, xors and
+    // shifts, so it stays in registers, and every seed gives an unrelated
+    // field. SeededNoise in seeded_noise.hpp is the scalar reference.
+    template <typename L>
+    struct SeededHash
+    {
+        explicit SeededHash(std::int32_t t_seed) : seed(L::splat_int(t_seed)) {}
+
+        typename L::Int finish(const typename L::Int h) const
+        {
+            const auto mixed = L::mul_int(L::xor_int(h, seed), L::splat_int(SeededNoise::MIX));
+            return L::xor_int(mixed, L::template shift_right<15>(mixed));
+        }
+
+        typename L::Int point2(const typename L::Int ix, const typename L::Int iy) const
+        {
+            return finish(L::xor_int(
+                L::mul_int(ix, L::splat_int(SeededNoise::PRIME_X)),
+                L::mul_int(iy, L::splat_int(SeededNoise::PRIME_Y))));
+        }
+
+        Corners2<L> cell2(const typename L::Int ix, const typename L::Int iy) const
+        {
+            const auto x0 = L::mul_int(ix, L::splat_int(SeededNoise::PRIME_X));
+            const auto y0 = L::mul_int(iy, L::splat_int(SeededNoise::PRIME_Y));
+            const auto x1 = L::add_int(x0, L::splat_int(SeededNoise::PRIME_X));
+            const auto y1 = L::add_int(y0, L::splat_int(SeededNoise::PRIME_Y));
+
+            return Corners2<L> {
+                finish(L::xor_int(x0, y0)),
+                finish(L::xor_int(x1, y0)),
+                finish(L::xor_int(x0, y1)),
+                finish(L::xor_int(x1, y1)),
+            };
+        }
+
+        Corners3<L> cell3(const typename L::Int ix, const typename L::Int iy, const typename L::Int iz) const
+        {
+            const auto x0 = L::mul_int(ix, L::splat_int(SeededNoise::PRIME_X));
+            const auto y0 = L::mul_int(iy, L::splat_int(SeededNoise::PRIME_Y));
+            const auto z0 = L::mul_int(iz, L::splat_int(SeededNoise::PRIME_Z));
+            const auto x1 = L::add_int(x0, L::splat_int(SeededNoise::PRIME_X));
+            const auto y1 = L::add_int(y0, L::splat_int(SeededNoise::PRIME_Y));
+            const auto z1 = L::add_int(z0, L::splat_int(SeededNoise::PRIME_Z));
+
+            const auto xy00 = L::xor_int(x0, y0);
+            const auto xy10 = L::xor_int(x1, y0);
+            const auto xy01 = L::xor_int(x0, y1);
+            const auto xy11 = L::xor_int(x1, y1);
+
+            return Corners3<L> {
+                finish(L::xor_int(xy00, z0)),
+                finish(L::xor_int(xy10, z0)),
+                finish(L::xor_int(xy01, z0)),
+                finish(L::xor_int(xy11, z0)),
+                finish(L::xor_int(xy00, z1)),
+                finish(L::xor_int(xy10, z1)),
+                finish(L::xor_int(xy01, z1)),
+                finish(L::xor_int(xy11, z1)),
+            };
+        }
+
+        typename L::Int seed;
+    };
+
+    template <typename L>
+    typename L::Float fade(const typename L::Float t)
+    {
+        // t * t * t * (t * (t * 6 - 15) + 10)
+        const auto inner = L::add(L::mul(t, L::sub(L::mul(t, L::splat(6.0f)), L::splat(15.0f))), L::splat(10.0f));
+        return L::mul(L::mul(L::mul(t, t), t), inner);
+    }
+
+    template <typename L>
+    typename L::Float lerp(const typename L::Float t, const typename L::Float a, const typename L::Float b)
+    {
+        return L::add(a, L::mul(t, L::sub(b, a)));
+    }
+
+    template <typename L>
+    typename L::Float grad(
+        const typename L::Int hash,
+        const typename L::Float x,
+        const typename L::Float y,
+        const typename L::Float z)
+    {
+        // Same 12 gradient directions as Perlin::grad, computed with selects
+        const auto h = L::and_int(hash, L::splat_int(15));
+        const auto u = L::select(L::less_int(h, L::splat_int(8)), x, y);
+        const auto is_x = L::mask_or(L::equal_int(h, L::splat_int(12)), L::equal_int(h, L::splat_int(14)));
+        const auto v = L::select(L::less_int(h, L::splat_int(4)), y, L::select(is_x, x, z));
+
+        const auto u_sign = L::template shift_left<31>(L::and_int(h, L::splat_int(1)));
+        const auto v_sign = L::template shift_left<30>(L::and_int(h, L::splat_int(2)));
+        return L::add(L::xor_sign(u, u_sign), L::xor_sign(v, v_sign));
+    }
+
+    // Noise value together with its partial derivatives
+    template <typename L>
+    struct Gradient2
+    {
+        typename L::Float value;
+        typename L::Float dx;
+        typename L::Float dy;
+    };
+
+    template <typename L>
+    struct Gradient3
+    {
+        typename L::Float value;
+        typename L::Float dx;
+        typename L::Float dy;
+        typename L::Float dz;
+    };
+
+    template <typename L>
+    typename L::Float fade_derivative(const typename L::Float t)
+    {
+        // 30 * t * t * (t - 1) * (t - 1)
+        const auto t1 = L::sub(t, L::splat(1.0f));
+        return L::mul(L::mul(L::mul(L::splat(30.0f), L::mul(t, t)), t1), t1);
+    }
+
+    template <typename L, typename H, bool Derivatives>
+    Gradient3<L> perlin3_sample(typename L::Float x, typename L::Float y, typename L::Float z, const H& hash)
+    {
+        const auto zero = L::splat(0.0f);
+        const auto one = L::splat(1.0f);
+
+        const auto floor_x = L::floor(x);
+        const auto floor_y = L::floor(y);
+        const auto floor_z = L::floor(z);
+
+        // unit cube that contains point
+        const auto corners = hash.cell3(L::to_int(floor_x), L::to_int(floor_y), L::to_int(floor_z));
+        const auto h000 = corners.h000;
+        const auto h100 = corners.h100;
+        const auto h010 = corners.h010;
+        const auto h110 = corners.h110;
+        const auto h001 = corners.h001;
+        const auto h101 = corners.h101;
+        const auto h011 = corners.h011;
+        const auto h111 = corners.h111;
+
+        // relative (x, y, z) of point in cube
+        x = L::sub(x, floor_x);
+        y = L::sub(y, floor_y);
+        z = L::sub(z, floor_z);
+
+        const auto u = fade<L>(x);
+        const auto v = fade<L>(y);
+        const auto w = fade<L>(z);
+
+        const auto x1 = L::sub(x, one);
+        const auto y1 = L::sub(y, one);
+        const auto z1 = L::sub(z, one);
+
+        const auto n000 = grad<L>(h000, x, y, z);
+        const auto n100 = grad<L>(h100, x1, y, z);
+        const auto n010 = grad<L>(h010, x, y1, z);
+        const auto n110 = grad<L>(h110, x1, y1, z);
+        const auto n001 = grad<L>(h001, x, y, z1);
+        const auto n101 = grad<L>(h101, x1, y, z1);
+        const auto n011 = grad<L>(h011, x, y1, z1);
+        const auto n111 = grad<L>(h111, x1, y1, z1);
+
+        Gradient3<L> result = {};
+        result.value = lerp<L>(w,
+            lerp<L>(v, lerp<L>(u, n000, n100), lerp<L>(u, n010, n110)),
+            lerp<L>(v, lerp<L>(u, n001, n101), lerp<L>(u, n011, n111)));
+
+        if constexpr(!Derivatives) {
+            return result;
+        }
+
+        // Derivative = trilinear blend of the corner gradients, plus the
+        // change in blend weights along each axis
+        const auto du = fade_derivative<L>(x);
+        const auto dv = fade_derivative<L>(y);
+        const auto dw = fade_derivative<L>(z);
+
+        const auto k1 = L::sub(n100, n000);
+        const auto k2 = L::sub(n010, n000);
+        const auto k3 = L::sub(n001, n000);
+        const auto k4 = L::add(L::sub(L::sub(n000, n100), n010), n110);
+        const auto k5 = L::add(L::sub(L::sub(n000, n010), n001), n011);
+        const auto k6 = L::add(L::sub(L::sub(n000, n100), n001), n101);
+        const auto k7 = L::add(L::sub(L::sub(L::add(L::sub(L::add(L::sub(n100, n000), n010), n110), n001), n101), n011), n111);
+
+        const auto blend = [&](const typename L::Float c000, const typename L::Float c100,
+                               const typename L::Float c010, const typename L::Float c110,
+                               const typename L::Float c001, const typename L::Float c101,
+                               const typename L::Float c011, const typename L::Float c111) {
+            return lerp<L>(w,
+                lerp<L>(v, lerp<L>(u, c000, c100), lerp<L>(u, c010, c110)),
+                lerp<L>(v, lerp<L>(u, c001, c101), lerp<L>(u, c011, c111)));
+        };
+
+        // Gradient vectors recovered by evaluating grad() along each axis
+        const auto axis = [&](const typename L::Float ex, const typename L::Float ey, const typename L::Float ez) {
+            return blend(
+                grad<L>(h000, ex, ey, ez), grad<L>(h100, ex, ey, ez),
+                grad<L>(h010, ex, ey, ez), grad<L>(h110, ex, ey, ez),
+                grad<L>(h001, ex, ey, ez), grad<L>(h101, ex, ey, ez),
+                grad<L>(h011, ex, ey, ez), grad<L>(h111, ex, ey, ez));
+        };
+
+        result.dx = L::add(axis(one, zero, zero),
+            L::mul(du, L::add(L::add(L::add(k1, L::mul(k4, v)), L::mul(k6, w)), L::mul(k7, L::mul(v, w)))));
+        result.dy = L::add(axis(zero, one, zero),
+            L::mul(dv, L::add(L::add(L::add(k2, L::mul(k5, w)), L::mul(k4, u)), L::mul(k7, L::mul(w, u)))));
+        result.dz = L::add(axis(zero, zero, one),
+            L::mul(dw, L::add(L::add(L::add(k3, L::mul(k6, u)), L::mul(k5, v)), L::mul(k7, L::mul(u, v)))));
+
+        return result;
+    }
+
+    template <typename L>
+    typename L::Float grad2(
+        const typename L::Int hash,
+        const typename L::Float x,
+        const typename L::Float y)
+    {
+        // 8 gradients of the form (+-1, +-2) and (+-2, +-1)
+        const auto h = L::and_int(hash, L::splat_int(7));
+        const auto swap = L::less_int(h, L::splat_int(4));
+        const auto u = L::select(swap, x, y);
+        const auto v = L::select(swap, y, x);
+
+        const auto u_sign = L::template shift_left<31>(L::and_int(h, L::splat_int(1)));
+        const auto v_sign = L::template shift_left<30>(L::and_int(h, L::splat_int(2)));
+        return L::add(L::xor_sign(u, u_sign), L::xor_sign(L::add(v, v), v_sign));
+    }
+
+    // Perlin noise on the 2D lattice: 4 corners and 2 fade curves per sample
+    // instead of the 8 corners and 3 fade curves of perlin3
+    template <typename L, typename H, bool Derivatives>
+    Gradient2<L> perlin2_sample(typename L::Float x, typename L::Float y, const H& hash)
+    {
+        // 1 / (sqrt(5) * sqrt(0.5)) bounds the result to [-1, 1]
+        const auto range = L::splat(0.63245553f);
+
+        const auto zero = L::splat(0.0f);
+        const auto one = L::splat(1.0f);
+
+        const auto floor_x = L::floor(x);
+        const auto floor_y = L::floor(y);
+
+        const auto corners = hash.cell2(L::to_int(floor_x), L::to_int(floor_y));
+        const auto h00 = corners.h00;
+        const auto h10 = corners.h10;
+        const auto h01 = corners.h01;
+        const auto h11 = corners.h11;
+
+        x = L::sub(x, floor_x);
+        y = L::sub(y, floor_y);
+
+        const auto u = fade<L>(x);
+        const auto v = fade<L>(y);
+
+        const auto x1 = L::sub(x, one);
+        const auto y1 = L::sub(y, one);
+
+        const auto n00 = grad2<L>(h00, x, y);
+        const auto n10 = grad2<L>(h10, x1, y);
+        const auto n01 = grad2<L>(h01, x, y1);
+        const auto n11 = grad2<L>(h11, x1, y1);
+
+        Gradient2<L> result = {};
+        result.value = L::mul(lerp<L>(v, lerp<L>(u, n00, n10), lerp<L>(u, n01, n11)), range);
+
+        if constexpr(!Derivatives) {
+            return result;
+        }
+
+        const auto du = fade_derivative<L>(x);
+        const auto dv = fade_derivative<L>(y);
+
+        const auto k1 = L::sub(n10, n00);
+        const auto k2 = L::sub(n01, n00);
+        const auto k4 = L::add(L::sub(L::sub(n00, n10), n01), n11);
+
+        const auto axis = [&](const typename L::Float ex, const typename L::Float ey) {
+            return lerp<L>(v,
+                lerp<L>(u, grad2<L>(h00, ex, ey), grad2<L>(h10, ex, ey)),
+                lerp<L>(u, grad2<L>(h01, ex, ey), grad2<L>(h11, ex, ey)));
+        };
+
+        result.dx = L::mul(L::add(axis(one, zero), L::mul(du, L::add(k1, L::mul(k4, v)))), range);
+        result.dy = L::mul(L::add(axis(zero, one), L::mul(dv, L::add(k2, L::mul(k4, u)))), range);
+
+        return result;
+    }
+
+    // Rehashes a lattice corner for channel > 0, so that every channel picks
+    // its own gradients from the shared corner hash
+    template <typename L>
+    typename L::Int channel_hash(const typename L::Int h, const std::size_t channel)
+    {
+        if(channel == 0) {
+            return h;
+        }
+
+        const auto salt = static_cast<std::int32_t>(static_cast<std::uint32_t>(channel) * 0x9E3779B9u);
+        return L::template shift_right<16>(L::mul_int(L::xor_int(h, L::splat_int(salt)), L::splat_int(SeededNoise::MIX)));
+    }
+
+    // Independent perlin2 layers at the same positions. The lattice cell,
+    // fade weights and corner hashes are shared and only the gradients differ
+    // per channel; channel 0 is exactly perlin2.
+    template <typename L, typename H>
+    void perlin2_channels_sample(typename L::Float x, typename L::Float y, const H& hash, const std::size_t channels, typename L::Float* out)
+    {
+        const auto range = L::splat(0.63245553f);
+        const auto one = L::splat(1.0f);
+
+        const auto floor_x = L::floor(x);
+        const auto floor_y = L::floor(y);
+
+        const auto corners = hash.cell2(L::to_int(floor_x), L::to_int(floor_y));
+
+        x = L::sub(x, floor_x);
+        y = L::sub(y, floor_y);
+
+        const auto u = fade<L>(x);
+        const auto v = fade<L>(y);
+
+        const auto x1 = L::sub(x, one);
+        const auto y1 = L::sub(y, one);
+
+        for(std::size_t c = 0; c < channels; c++) {
+            const auto n00 = grad2<L>(channel_hash<L>(corners.h00, c), x, y);
+            const auto n10 = grad2<L>(channel_hash<L>(corners.h10, c), x1, y);
+            const auto n01 = grad2<L>(channel_hash<L>(corners.h01, c), x, y1);
+            const auto n11 = grad2<L>(channel_hash<L>(corners.h11, c), x1, y1);
+
+            out[c] = L::mul(lerp<L>(v, lerp<L>(u, n00, n10), lerp<L>(u, n01, n11)), range);
+        }
+    }
+
+    template <typename L, bool Derivatives>
+    Gradient2<L> simplex2_corner(
+        const typename L::Int hash,
+        const typename L::Float x,
+        const typename L::Float y)
+    {
+        // (0.5 - r^2)^4 falloff, clamped to zero outside the kernel radius
+        const auto r2 = L::add(L::mul(x, x), L::mul(y, y));
+        const auto a = L::max(L::sub(L::splat(0.5f), r2), L::splat(0.0f));
+        const auto a2 = L::mul(a, a);
+        const auto a4 = L::mul(a2, a2);
+        const auto g = grad2<L>(hash, x, y);
+
+        Gradient2<L> result = {};
+        result.value = L::mul(a4, g);
+
+        if constexpr(!Derivatives) {
+            return result;
+        }
+
+        // d/dx (a^4 * g.d) = a^4 * g.x - 8 * a^3 * x * g.d
+        const auto falloff = L::mul(L::mul(L::splat(8.0f), L::mul(a2, a)), g);
+        result.dx = L::sub(L::mul(a4, grad2<L>(hash, L::splat(1.0f), L::splat(0.0f))), L::mul(falloff, x));
+        result.dy = L::sub(L::mul(a4, grad2<L>(hash, L::splat(0.0f), L::splat(1.0f))), L::mul(falloff, y));
+        return result;
+    }
+
+    // OpenSimplex2-style 2D simplex noise: 3 corners per sample on a skewed
+    // triangular lattice, with radial falloff instead of fade curves
+    template <typename L, typename H, bool Derivatives>
+    Gradient2<L> simplex2_sample(typename L::Float x, typename L::Float y, const H& hash)
+    {
+        // (sqrt(3) - 1) / 2 and (3 - sqrt(3)) / 6
+        constexpr auto skew = 0.36602540378f;
+        constexpr auto unskew = 0.21132486540f;
+
+        // scales the result to roughly [-1, 1]
+        const auto range = L::splat(40.0f);
+
+        const auto zero = L::splat(0.0f);
+        const auto one = L::splat(1.0f);
+        const auto zero_int = L::splat_int(0);
+        const auto one_int = L::splat_int(1);
+
+        // skew into the simplex cell containing the point
+        const auto s = L::mul(L::add(x, y), L::splat(skew));
+        const auto cell_i = L::floor(L::add(x, s));
+        const auto cell_j = L::floor(L::add(y, s));
+
+        const auto t = L::mul(L::add(cell_i, cell_j), L::splat(unskew));
+        const auto x0 = L::sub(x, L::sub(cell_i, t));
+        const auto y0 = L::sub(y, L::sub(cell_j, t));
+
+        // pick the lower or upper triangle of the cell
+        const auto lower = L::less(y0, x0);
+        const auto i1 = L::select_int(lower, one_int, zero_int);
+        const auto j1 = L::select_int(lower, zero_int, one_int);
+
+        const auto x1 = L::add(L::sub(x0, L::select(lower, one, zero)), L::splat(unskew));
+        const auto y1 = L::add(L::sub(y0, L::select(lower, zero, one)), L::splat(unskew));
+        const auto x2 = L::add(L::sub(x0, one), L::splat(2.0f * unskew));
+        const auto y2 = L::add(L::sub(y0, one), L::splat(2.0f * unskew));
+
+        const auto ii = L::to_int(cell_i);
+        const auto jj = L::to_int(cell_j);
+
+        const auto hash0 = hash.point2(ii, jj);
+        const auto hash1 = hash.point2(L::add_int(ii, i1), L::add_int(jj, j1));
+        const auto hash2 = hash.point2(L::add_int(ii, one_int), L::add_int(jj, one_int));
+
+        const auto c0 = simplex2_corner<L, Derivatives>(hash0, x0, y0);
+        const auto c1 = simplex2_corner<L, Derivatives>(hash1, x1, y1);
+        const auto c2 = simplex2_corner<L, Derivatives>(hash2, x2, y2);
+
+        // corner offsets move one-for-one with the input, so the derivatives
+        // simply add up
+        Gradient2<L> result = {};
+        result.value = L::mul(L::add(L::add(c0.value, c1.value), c2.value), range);
+
+        if constexpr(!Derivatives) {
+            return result;
+        }
+        result.dx = L::mul(L::add(L::add(c0.dx, c1.dx), c2.dx), range);
+        result.dy = L::mul(L::add(L::add(c0.dy, c1.dy), c2.dy), range);
+        return result;
+    }
+
+    template <typename L, typename H, bool Derivatives, Gradient2<L> (*Kernel)(typename L::Float, typename L::Float, const H&)>
+    void batch2(const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, std::int32_t seed)
+    {
+        const H hash(seed);
+
+        std::size_t i = 0;
+        for(; i + L::width <= count; i += L::width) {
+            const auto result = Kernel(L::load(x + i), L::load(y + i), hash);
+            L::store(out + i, result.value);
+            if constexpr(Derivatives) {
+                L::store(out_dx + i, result.dx);
+                L::store(out_dy + i, result.dy);
+            }
+        }
+
+        // Pad the tail out to a full register rather than falling back to a
+        // different code path, so every sample goes through the same math
+        if(i < count) {
+            float tail_x[L::width] = {};
+            float tail_y[L::width] = {};
+            float tail_out[L::width];
+            float tail_dx[L::width];
+            float tail_dy[L::width];
+
+            const auto remaining = count - i;
+            for(std::size_t j = 0; j < remaining; j++) {
+                tail_x[j] = x[i + j];
+                tail_y[j] = y[i + j];
+            }
+
+            const auto result = Kernel(L::load(tail_x), L::load(tail_y), hash);
+            L::store(tail_out, result.value);
+            L::store(tail_dx, result.dx);
+            L::store(tail_dy, result.dy);
+
+            for(std::size_t j = 0; j < remaining; j++) {
+                out[i + j] = tail_out[j];
+                if constexpr(Derivatives) {
+                    out_dx[i + j] = tail_dx[j];
+                    out_dy[i + j] = tail_dy[j];
+                }
+            }
+        }
+    }
+
+    template <typename L, typename H, bool Derivatives, Gradient3<L> (*Kernel)(typename L::Float, typename L::Float, typename L::Float, const H&)>
+    void batch3(const float* x, const float* y, const float* z, float* out, float* out_dx, float* out_dy, float* out_dz, std::size_t count, std::int32_t seed)
+    {
+        const H hash(seed);
+
+        std::size_t i = 0;
+        for(; i + L::width <= count; i += L::width) {
+            const auto result = Kernel(L::load(x + i), L::load(y + i), L::load(z + i), hash);
+            L::store(out + i, result.value);
+            if constexpr(Derivatives) {
+                L::store(out_dx + i, result.dx);
+                L::store(out_dy + i, result.dy);
+                L::store(out_dz + i, result.dz);
+            }
+        }
+
+        if(i < count) {
+            float tail_x[L::width] = {};
+            float tail_y[L::width] = {};
+            float tail_z[L::width] = {};
+            float tail_out[L::width];
+            float tail_dx[L::width];
+            float tail_dy[L::width];
+            float tail_dz[L::width];
+
+            const auto remaining = count - i;
+            for(std::size_t j = 0; j < remaining; j++) {
+                tail_x[j] = x[i + j];
+                tail_y[j] = y[i + j];
+                tail_z[j] = z[i + j];
+            }
+
+            const auto result = Kernel(L::load(tail_x), L::load(tail_y), L::load(tail_z), hash);
+            L::store(tail_out, result.value);
+            L::store(tail_dx, result.dx);
+            L::store(tail_dy, result.dy);
+            L::store(tail_dz, result.dz);
+
+            for(std::size_t j = 0; j < remaining; j++) {
+                out[i + j] = tail_out[j];
+                if constexpr(Derivatives) {
+                    out_dx[i + j] = tail_dx[j];
+                    out_dy[i + j] = tail_dy[j];
+                    out_dz[i + j] = tail_dz[j];
+                }
+            }
+        }
+    }
+
+    template <typename L, typename H>
+    void batch2_channels(const float* x, const float* y, float* const* out, std::size_t channels, std::size_t count, std::int32_t seed)
+    {
+        const H hash(seed);
+        channels = channels < max_noise_channels ? channels : max_noise_channels;
+
+        typename L::Float values[max_noise_channels];
+
+        std::size_t i = 0;
+        for(; i + L::width <= count; i += L::width) {
+            perlin2_channels_sample<L, H>(L::load(x + i), L::load(y + i), hash, channels, values);
+            for(std::size_t c = 0; c < channels; c++) {
+                L::store(out[c] + i, values[c]);
+            }
+        }
+
+        if(i < count) {
+            float tail_x[L::width] = {};
+            float tail_y[L::width] = {};
+            float tail_out[L::width];
+
+            const auto remaining = count - i;
+            for(std::size_t j = 0; j < remaining; j++) {
+                tail_x[j] = x[i + j];
+                tail_y[j] = y[i + j];
+            }
+
+            perlin2_channels_sample<L, H>(L::load(tail_x), L::load(tail_y), hash, channels, values);
+            for(std::size_t c = 0; c < channels; c++) {
+                L::store(tail_out, values[c]);
+                for(std::size_t j = 0; j < remaining; j++) {
+                    out[c][i + j] = tail_out[j];
+                }
+            }
+        }
+    }
+
+    template <typename L, typename H>
+    NoiseKernelSet make_noise_kernel_set()
+    {
+        return NoiseKernelSet {
+            batch3<L, H, false, perlin3_sample<L, H, false>>,
+            batch2<L, H, false, perlin2_sample<L, H, false>>,
+            batch2<L, H, false, simplex2_sample<L, H, false>>,
+            batch3<L, H, true, perlin3_sample<L, H, true>>,
+            batch2<L, H, true, perlin2_sample<L, H, true>>,
+            batch2<L, H, true, simplex2_sample<L, H, true>>,
+            batch2_channels<L, H>,
+        };
+    }
+
+    template <typename L>
+    NoiseKernelTable make_noise_kernel_table()
+    {
+        return NoiseKernelTable {
+            make_noise_kernel_set<L, PermutationHash<L>>(),
+            make_noise_kernel_set<L, SeededHash<L>>(),
+        };
+    }
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+// Thin wrappers over the SIMD register types used by the batch noise kernels.
+// Every kernel in noise_kernels.hpp is written once against this interface
+// and instantiated per instruction set, so the scalar lanes perform exactly
+// the same sequence of float operations as the vector ones.
+//
+// Each wrapper is only visible when its translation unit is compiled with the
+// matching -m flag (see src/CMakeLists.txt).
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE4_2__) || defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    struct ScalarLanes
+    {
+        using Float = float;
+        using Int = std::int32_t;
+        using Mask = bool;
+
+        static constexpr std::size_t width = 1;
+
+        static Float load(const float* p) { return *p; }
+        static void store(float* p, Float v) { *p = v; }
+        static Float splat(float f) { return f; }
+        static Int splat_int(std::int32_t i) { return i; }
+
+        static Float add(Float a, Float b) { return a + b; }
+        static Float sub(Float a, Float b) { return a - b; }
+        static Float mul(Float a, Float b) { return a * b; }
+        static Float min(Float a, Float b) { return a < b ? a : b; }
+        static Float max(Float a, Float b) { return a > b ? a : b; }
+        static Float floor(Float a) { return std::floor(a); }
+
+        static Int to_int(Float a) { return static_cast<Int>(a); }
+        static Float to_float(Int a) { return static_cast<Float>(a); }
+
+        static Int add_int(Int a, Int b) { return static_cast<Int>(static_cast<std::uint32_t>(a) + static_cast<std::uint32_t>(b)); }
+        static Int and_int(Int a, Int b) { return a & b; }
+        static Int mul_int(Int a, Int b) { return static_cast<Int>(static_cast<std::uint32_t>(a) * static_cast<std::uint32_t>(b)); }
+        static Int xor_int(Int a, Int b) { return a ^ b; }
+
+        template <int Shift>
+        static Int shift_left(Int a) { return static_cast<Int>(static_cast<std::uint32_t>(a) << Shift); }
+
+        // Logical shift
+        template <int Shift>
+        static Int shift_right(Int a) { return static_cast<Int>(static_cast<std::uint32_t>(a) >> Shift); }
+
+        static Mask less_int(Int a, Int b) { return a < b; }
+        static Mask less(Float a, Float b) { return a < b; }
+        static Mask equal_int(Int a, Int b) { return a == b; }
+        static Mask mask_or(Mask a, Mask b) { return a || b; }
+        static Float select(Mask m, Float if_true, Float if_false) { return m ? if_true : if_false; }
+        static Int select_int(Mask m, Int if_true, Int if_false) { return m ? if_true : if_false; }
+
+        // Flips the sign of v wherever sign_bits has bit 31 set
+        static Float xor_sign(Float v, Int sign_bits)
+        {
+            std::uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            bits ^= static_cast<std::uint32_t>(sign_bits);
+            std::memcpy(&v, &bits, sizeof(bits));
+            return v;
+        }
+
+        static Int gather(const std::int32_t* table, Int index) { return table[index]; }
+    };
+
+#if defined(__SSE4_2__)
+    struct Sse42Lanes
+    {
+        using Float = __m128;
+        using Int = __m128i;
+        using Mask = __m128i;
+
+        static constexpr std::size_t width = 4;
+
+        static Float load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+        static Float splat(float f) { return _mm_set1_ps(f); }
+        static Int splat_int(std::int32_t i) { return _mm_set1_epi32(i); }
+
+        static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static Float floor(Float a) { return _mm_floor_ps(a); }
+
+        static Int to_int(Float a) { return _mm_cvttps_epi32(a); }
+        static Float to_float(Int a) { return _mm_cvtepi32_ps(a); }
+
+        static Int add_int(Int a, Int b) { return _mm_add_epi32(a, b); }
+        static Int and_int(Int a, Int b) { return _mm_and_si128(a, b); }
+        static Int mul_int(Int a, Int b) { return _mm_mullo_epi32(a, b); }
+        static Int xor_int(Int a, Int b) { return _mm_xor_si128(a, b); }
+
+        template <int Shift>
+        static Int shift_left(Int a) { return _mm_slli_epi32(a, Shift); }
+
+        template <int Shift>
+        static Int shift_right(Int a) { return _mm_srli_epi32(a, Shift); }
+
+        static Mask less_int(Int a, Int b) { return _mm_cmplt_epi32(a, b); }
+        static Mask less(Float a, Float b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+        static Mask equal_int(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+        static Mask mask_or(Mask a, Mask b) { return _mm_or_si128(a, b); }
+        static Float select(Mask m, Float if_true, Float if_false) { return _mm_blendv_ps(if_false, if_true, _mm_castsi128_ps(m)); }
+        static Int select_int(Mask m, Int if_true, Int if_false) { return _mm_blendv_epi8(if_false, if_true, m); }
+
+        static Float xor_sign(Float v, Int sign_bits) { return _mm_xor_ps(v, _mm_castsi128_ps(sign_bits)); }
+
+        // SSE has no gather, so pull each lane through the table by hand
+        static Int gather(const std::int32_t* table, Int index)
+        {
+            return _mm_setr_epi32(
+                table[_mm_extract_epi32(index, 0)],
+                table[_mm_extract_epi32(index, 1)],
+                table[_mm_extract_epi32(index, 2)],
+                table[_mm_extract_epi32(index, 3)]);
+        }
+    };
+#endif
+
+#if defined(__AVX2__)
+    struct Avx2Lanes
+    {
+        using Float = __m256;
+        using Int = __m256i;
+        using Mask = __m256i;
+
+        static constexpr std::size_t width = 8;
+
+        static Float load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+        static Float splat(float f) { return _mm256_set1_ps(f); }
+        static Int splat_int(std::int32_t i) { return _mm256_set1_epi32(i); }
+
+        static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        static Float floor(Float a) { return _mm256_floor_ps(a); }
+
+        static Int to_int(Float a) { return _mm256_cvttps_epi32(a); }
+        static Float to_float(Int a) { return _mm256_cvtepi32_ps(a); }
+
+        static Int add_int(Int a, Int b) { return _mm256_add_epi32(a, b); }
+        static Int and_int(Int a, Int b) { return _mm256_and_si256(a, b); }
+        static Int mul_int(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+        static Int xor_int(Int a, Int b) { return _mm256_xor_si256(a, b); }
+
+        template <int Shift>
+        static Int shift_left(Int a) { return _mm256_slli_epi32(a, Shift); }
+
+        template <int Shift>
+        static Int shift_right(Int a) { return _mm256_srli_epi32(a, Shift); }
+
+        static Mask less_int(Int a, Int b) { return _mm256_cmpgt_epi32(b, a); }
+        static Mask less(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+        static Mask equal_int(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+        static Mask mask_or(Mask a, Mask b) { return _mm256_or_si256(a, b); }
+        static Float select(Mask m, Float if_true, Float if_false) { return _mm256_blendv_ps(if_false, if_true, _mm256_castsi256_ps(m)); }
+        static Int select_int(Mask m, Int if_true, Int if_false) { return _mm256_blendv_epi8(if_false, if_true, m); }
+
+        static Float xor_sign(Float v, Int sign_bits) { return _mm256_xor_ps(v, _mm256_castsi256_ps(sign_bits)); }
+
+        static Int gather(const std::int32_t* table, Int index) { return _mm256_i32gather_epi32(table, index, 4); }
+    };
+#endif
+
+#if defined(__AVX512F__)
+    struct Avx512Lanes
+    {
+        using Float = __m512;
+        using Int = __m512i;
+        using Mask = __mmask16;
+
+        static constexpr std::size_t width = 16;
+
+        static Float load(const float* p) { return _mm512_loadu_ps(p); }
+        static void store(float* p, Float v) { _mm512_storeu_ps(p, v); }
+        static Float splat(float f) { return _mm512_set1_ps(f); }
+        static Int splat_int(std::int32_t i) { return _mm512_set1_epi32(i); }
+
+        static Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm512_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm512_max_ps(a, b); }
+        static Float floor(Float a) { return _mm512_mask_roundscale_ps(a, 0xFFFF, a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+
+        static Int to_int(Float a) { return _mm512_cvttps_epi32(a); }
+        static Float to_float(Int a) { return _mm512_cvtepi32_ps(a); }
+
+        static Int add_int(Int a, Int b) { return _mm512_add_epi32(a, b); }
+        static Int and_int(Int a, Int b) { return _mm512_and_si512(a, b); }
+        static Int mul_int(Int a, Int b) { return _mm512_mullo_epi32(a, b); }
+        static Int xor_int(Int a, Int b) { return _mm512_xor_si512(a, b); }
+
+        template <int Shift>
+        static Int shift_left(Int a) { return _mm512_slli_epi32(a, Shift); }
+
+        template <int Shift>
+        static Int shift_right(Int a) { return _mm512_srli_epi32(a, Shift); }
+
+        static Mask less_int(Int a, Int b) { return _mm512_cmplt_epi32_mask(a, b); }
+        static Mask less(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static Mask equal_int(Int a, Int b) { return _mm512_cmpeq_epi32_mask(a, b); }
+        static Mask mask_or(Mask a, Mask b) { return _mm512_kor(a, b); }
+        static Float select(Mask m, Float if_true, Float if_false) { return _mm512_mask_blend_ps(m, if_false, if_true); }
+        static Int select_int(Mask m, Int if_true, Int if_false) { return _mm512_mask_blend_epi32(m, if_false, if_true); }
+
+        static Float xor_sign(Float v, Int sign_bits) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), sign_bits)); }
+
+        static Int gather(const std::int32_t* table, Int index) { return _mm512_i32gather_epi32(index, table, 4); }
+    };
+#endif
+}
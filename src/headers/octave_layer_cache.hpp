@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "noise_batch.hpp"
+#include "tiled_grid.hpp"
+
+// Everything that decides the samples of one terrain octave. The amplitude
+// isn't part of it, so layers survive persistence changes, and the octave
+// count isn't either, so adding or removing top octaves keeps the rest.
+struct OctaveLayerKey {
+    int seed;
+    float scale;
+    float lacunarity;
+    glm::vec2 offset;
+    NoiseType noise_type;
+    LatticeHash lattice_hash;
+    float warp_strength;
+    float warp_scale;
+    glm::ivec2 origin;
+    int spacing;
+    unsigned int grid_size;
+    int octave;
+
+    bool operator==(const OctaveLayerKey& other) const {
+        return seed == other.seed &&
+               scale == other.scale &&
+               lacunarity == other.lacunarity &&
+               offset == other.offset &&
+               noise_type == other.noise_type &&
+               lattice_hash == other.lattice_hash &&
+               warp_strength == other.warp_strength &&
+               warp_scale == other.warp_scale &&
+               origin == other.origin &&
+               spacing == other.spacing &&
+               grid_size == other.grid_size &&
+               octave == other.octave;
+    }
+};
+
+// One octave of noise and its slopes over the whole grid, before the
+// octave's amplitude and frequency are applied
+struct OctaveLayer {
+    OctaveLayerKey key;
+    MapGrid values;
+    MapGrid slope_x;
+    MapGrid slope_y;
+
+    // Finest stride at which every sample is filled in, 0 while none is
+    unsigned int stride;
+    std::uint64_t last_used;
+};
+
+struct OctaveLayerStats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::size_t bytes;
+    std::size_t budget;
+
+    float hit_rate() const {
+        return hits + misses > 0 ? float(hits) / float(hits + misses) : 0.0f;
+    }
+};
+
+// Keeps the most recently used octave layers within a memory budget. Only
+// the generation thread acquires layers; the budget and the stats can be
+// used from any thread. A budget of 0 turns the cache off.
+class OctaveLayerCache {
+public:
+    explicit OctaveLayerCache(std::size_t t_budget);
+
+    OctaveLayerCache(const OctaveLayerCache&) = delete;
+    OctaveLayerCache& operator=(const OctaveLayerCache&) = delete;
+
+    bool enabled() const {
+        return budget.load() > 0;
+    }
+
+    // Starts a new evaluation pass, first shrinking the cache to the
+    // current budget. Layers acquired during a pass aren't evicted before
+    // the next one starts.
+    void begin_pass();
+
+    // Layer for key, created empty if it isn't cached yet. Counts a hit when
+    // the layer is complete at stride. Returns nullptr when it doesn't fit
+    // in the budget next to the layers in use this pass.
+    OctaveLayer* acquire(const OctaveLayerKey& key, unsigned int stride);
+
+    // Drops every layer, freeing its memory
+    void clear();
+
+    void set_budget(std::size_t t_budget);
+    OctaveLayerStats stats() const;
+
+private:
+    static std::size_t layer_bytes(unsigned int grid_size);
+
+    // Removes the least recently used layer from an earlier pass, returning
+    // nullptr if there isn't one
+    std::unique_ptr<OctaveLayer> evict_one();
+
+    std::vector<std::unique_ptr<OctaveLayer>> layers;
+    std::uint64_t pass;
+
+    std::atomic<std::size_t> budget;
+    std::atomic<std::size_t> bytes;
+    std::atomic<std::uint64_t> hits;
+    std::atomic<std::uint64_t> misses;
+};
@@ -2,6 +2,9 @@
 // C++ implementation of Ken Perlin's "Improved Noise reference implementation"
 // Located here: https://mrl.nyu.edu/~perlin/noise/
 //
+
+#pragma once
+
 #include <cmath>
 #include <cstdint>
 #include <type_traits>
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Right triangulated irregular network: the binary tree of right triangles
+// made by halving a square along its diagonal and each triangle again from
+// its right angle to the middle of its hypotenuse. A grid of 2^k + 1
+// samples a side holds the whole tree, and any cut through it is a mesh
+// without cracks as long as the triangles sharing a hypotenuse split
+// together.
+//
+// The error of a triangle is how far the middle sample of its hypotenuse is
+// from the line it would be drawn with, and no less than the errors of its
+// descendants or of its neighbour across the hypotenuse. Keeping them on the
+// middle samples, which the two triangles sharing a hypotenuse have in
+// common, makes both split together.
+//
+// Squares of any width are covered by the smallest such grid. Triangles
+// reaching past the width always split, and those left outside it once
+// small enough are dropped.
+class Rtin {
+public:
+    explicit Rtin(const unsigned int t_width) : width(t_width), cells(1) {
+        if (width < 2 || width > max_width) {
+            throw std::invalid_argument("Adaptive meshes take 2 to 32769 samples a side, not " + std::to_string(width));
+        }
+
+        while (cells + 1 < width) {
+            cells *= 2;
+        }
+
+        const auto grid = cells + 1;
+        heights.resize(std::size_t(grid) * grid);
+        errors.resize(std::size_t(grid) * grid);
+
+        // Corners of the hypotenuse of every triangle that has a middle
+        // sample, numbered as a heap below the two halves of the square:
+        // children are 2i and 2i + 1, so coarser triangles come first
+        const auto count = triangle_count();
+        coords.resize(std::size_t(count) * 4);
+        for (std::size_t i = 0; i < count; i++) {
+            auto id = i + 2;
+            unsigned int ax = 0, az = 0, bx = 0, bz = 0, cx = 0, cz = 0;
+            if (id & 1) {
+                bx = bz = cx = cells;
+            } else {
+                ax = az = cz = cells;
+            }
+
+            while ((id >>= 1) > 1) {
+                const auto mx = (ax + bx) / 2;
+                const auto mz = (az + bz) / 2;
+                if (id & 1) {
+                    bx = ax;
+                    bz = az;
+                    ax = cx;
+                    az = cz;
+                } else {
+                    ax = bx;
+                    az = bz;
+                    bx = cx;
+                    bz = cz;
+                }
+                cx = mx;
+                cz = mz;
+            }
+
+            coords[i * 4 + 0] = static_cast<std::uint16_t>(ax);
+            coords[i * 4 + 1] = static_cast<std::uint16_t>(az);
+            coords[i * 4 + 2] = static_cast<std::uint16_t>(bx);
+            coords[i * 4 + 3] = static_cast<std::uint16_t>(bz);
+        }
+    }
+
+    // Measures every triangle of the tree against height(x, z), which is
+    // read once for each x, z below the width. Finer triangles are measured
+    // first, so their errors are final when their parents take them in.
+    template <typename F>
+    void update(F&& height) {
+        const auto grid = cells + 1;
+        for (unsigned int x = 0; x < width; x++) {
+            for (unsigned int z = 0; z < width; z++) {
+                heights[x * grid + z] = height(x, z);
+            }
+        }
+        std::fill(errors.begin(), errors.end(), 0.0f);
+
+        const auto count = triangle_count();
+        const auto parents = count - cells * cells;
+        for (auto i = count; i-- > 0;) {
+            const unsigned int ax = coords[i * 4 + 0];
+            const unsigned int az = coords[i * 4 + 1];
+            const unsigned int bx = coords[i * 4 + 2];
+            const unsigned int bz = coords[i * 4 + 3];
+            const auto mx = (ax + bx) / 2;
+            const auto mz = (az + bz) / 2;
+            const auto cx = mx + mz - az;
+            const auto cz = mz + ax - mx;
+            if (outside(ax, az, bx, bz, cx, cz)) {
+                continue;
+            }
+
+            auto error = std::numeric_limits<float>::infinity();
+            if (std::max({ ax, bx, cx }) < width && std::max({ az, bz, cz }) < width) {
+                const auto line = 0.5f * (heights[ax * grid + az] + heights[bx * grid + bz]);
+                error = std::abs(line - heights[mx * grid + mz]);
+            }
+
+            auto& middle = errors[mx * grid + mz];
+            middle = std::max(middle, error);
+            if (i < parents) {
+                const auto left = ((ax + cx) / 2) * grid + (az + cz) / 2;
+                const auto right = ((bx + cx) / 2) * grid + (bz + cz) / 2;
+                middle = std::max({ middle, errors[left], errors[right] });
+            }
+        }
+    }
+
+    // Appends the coarsest mesh of the last update whose triangles are all
+    // within max_error of the samples, as index_of(x, z) of their corners.
+    // Only the triangles drawn are visited, so it takes time in proportion
+    // to the mesh. Corners wind the same way as the regular grid's cells.
+    template <typename F>
+    void extract(const float max_error, std::vector<unsigned int>& indices, F&& index_of) const {
+        add_triangle(0, 0, cells, cells, cells, 0, max_error, indices, index_of);
+        add_triangle(cells, cells, 0, 0, 0, cells, max_error, indices, index_of);
+    }
+
+    static constexpr unsigned int max_width = 32769;
+
+private:
+    // Triangles with a middle sample to split at
+    std::size_t triangle_count() const {
+        return std::size_t(cells) * cells * 2 - 2;
+    }
+
+    // True when no corner is within the width along one of the axes, which
+    // leaves the whole triangle past it
+    bool outside(unsigned int ax, unsigned int az, unsigned int bx, unsigned int bz, unsigned int cx, unsigned int cz) const {
+        return std::min({ ax, bx, cx }) >= width || std::min({ az, bz, cz }) >= width;
+    }
+
+    // Triangle a b c, right angled at c
+    template <typename F>
+    void add_triangle(
+        unsigned int ax, unsigned int az,
+        unsigned int bx, unsigned int bz,
+        unsigned int cx, unsigned int cz,
+        const float max_error,
+        std::vector<unsigned int>& indices,
+        F& index_of) const
+    {
+        if (outside(ax, az, bx, bz, cx, cz)) {
+            return;
+        }
+
+        const auto mx = (ax + bx) / 2;
+        const auto mz = (az + bz) / 2;
+        const auto splits = std::abs(static_cast<int>(ax) - static_cast<int>(cx)) + std::abs(static_cast<int>(az) - static_cast<int>(cz)) > 1;
+        if (splits && errors[mx * (cells + 1) + mz] > max_error) {
+            add_triangle(cx, cz, ax, az, mx, mz, max_error, indices, index_of);
+            add_triangle(bx, bz, cx, cz, mx, mz, max_error, indices, index_of);
+            return;
+        }
+
+        // Only the smallest triangles are left reaching past the width
+        if (std::max({ ax, bx, cx }) >= width || std::max({ az, bz, cz }) >= width) {
+            return;
+        }
+
+        indices.push_back(index_of(ax, az));
+        indices.push_back(index_of(bx, bz));
+        indices.push_back(index_of(cx, cz));
+    }
+
+    unsigned int width;
+    unsigned int cells;
+    std::vector<std::uint16_t> coords;
+    std::vector<float> heights;
+    std::vector<float> errors;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Contiguous run of scratch elements, used like the std::vector it replaces
+template <typename T>
+struct ScratchSpan {
+    T* first;
+    std::size_t count;
+
+    T* data() const {
+        return first;
+    }
+
+    T* begin() const {
+        return first;
+    }
+
+    T* end() const {
+        return first + count;
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    T& operator[](std::size_t i) const {
+        return first[i];
+    }
+};
+
+struct ScratchStats {
+    // Chunks allocated since the arena was created, which stops growing
+    // once generations reach their steady state
+    std::uint64_t allocations;
+    std::size_t bytes;
+};
+
+// Memory for the short-lived buffers of a generation, kept from one
+// generation to the next instead of allocated per tile. Every scheduler
+// thread has its own stack of chunks. A ScratchFrame takes memory from the
+// top of the calling thread's stack and hands all of it back when it ends,
+// so frames nest the same way as the tasks a thread runs while it waits on
+// a batch. A frame that doesn't fit adds a chunk; once a thread's stack is
+// empty again its chunks are merged into one big enough for all of them.
+// Threads outside the scheduler's pool share a stack, so only one of them
+// may use an arena.
+class ScratchArena {
+public:
+    ScratchArena();
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    ScratchStats stats() const;
+
+private:
+    friend class ScratchFrame;
+
+    struct Chunk {
+        std::unique_ptr<std::byte[]> memory;
+        std::size_t size;
+    };
+
+    // Padded so threads don't share the cache line of their stack's top
+    struct alignas(64) Stack {
+        std::vector<Chunk> chunks;
+        std::size_t chunk = 0;
+        std::size_t used = 0;
+        std::size_t frames = 0;
+    };
+
+    Stack& local_stack();
+    void* take(Stack& stack, std::size_t bytes, std::size_t alignment);
+    void release(Stack& stack, std::size_t chunk, std::size_t used);
+    void add_chunk(Stack& stack, std::size_t size);
+
+    static constexpr std::size_t min_chunk_size = 64 << 10;
+
+    std::vector<Stack> stacks;
+    std::atomic<std::uint64_t> allocations;
+    std::atomic<std::size_t> bytes;
+};
+
+// Scratch allocations of one scope on the calling thread. Elements are value
+// initialised like a std::vector's and must not need destroying.
+class ScratchFrame {
+public:
+    explicit ScratchFrame(ScratchArena& t_arena);
+    ~ScratchFrame();
+
+    ScratchFrame(const ScratchFrame&) = delete;
+    ScratchFrame& operator=(const ScratchFrame&) = delete;
+
+    template <typename T>
+    ScratchSpan<T> take(std::size_t count, const T& value = T()) {
+        static_assert(std::is_trivially_destructible_v<T>, "scratch is released without destroying it");
+
+        const auto first = static_cast<T*>(arena.take(stack, count * sizeof(T), alignof(T)));
+        std::uninitialized_fill_n(first, count, value);
+        return ScratchSpan<T> { first, count };
+    }
+
+private:
+    ScratchArena& arena;
+    ScratchArena::Stack& stack;
+    std::size_t chunk;
+    std::size_t used;
+};
@@ -0,0 +1,317 @@
+//
+// Scalar reference for the seeded integer-hash lattice that NoiseBatch uses
+// with LatticeHash::SEEDED. It is written as plain C++ in the same order of
+// float operations as the batch kernels, so the output of any SIMD level can
+// be compared against it bit for bit (with -ffp-contract=off on FMA targets).
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+class SeededNoise
+{
+public:
+    // Large odd primes spread neighbouring lattice coordinates across the
+    // whole 32-bit range; MIX is the finaliser multiplier
+    static constexpr std::int32_t PRIME_X = 501125321;
+    static constexpr std::int32_t PRIME_Y = 1136930381;
+    static constexpr std::int32_t PRIME_Z = 1720413743;
+    static constexpr std::int32_t MIX = 0x27d4eb2d;
+
+    static std::uint32_t hash(const std::int32_t seed, const std::int32_t x, const std::int32_t y)
+    {
+        return finish(seed, prime(x, PRIME_X) ^ prime(y, PRIME_Y));
+    }
+
+    static std::uint32_t hash(const std::int32_t seed, const std::int32_t x, const std::int32_t y, const std::int32_t z)
+    {
+        return finish(seed, prime(x, PRIME_X) ^ prime(y, PRIME_Y) ^ prime(z, PRIME_Z));
+    }
+
+    // Noise value together with its partial derivatives
+    struct Gradient2
+    {
+        float value;
+        float dx;
+        float dy;
+    };
+
+    struct Gradient3
+    {
+        float value;
+        float dx;
+        float dy;
+        float dz;
+    };
+
+    static float perlin3(const std::int32_t seed, const float x, const float y, const float z)
+    {
+        return perlin3_gradient(seed, x, y, z).value;
+    }
+
+    static float perlin2(const std::int32_t seed, const float x, const float y)
+    {
+        return perlin2_gradient(seed, x, y).value;
+    }
+
+    static float simplex2(const std::int32_t seed, const float x, const float y)
+    {
+        return simplex2_gradient(seed, x, y).value;
+    }
+
+    static Gradient3 perlin3_gradient(const std::int32_t seed, float x, float y, float z)
+    {
+        const auto floor_x = std::floor(x);
+        const auto floor_y = std::floor(y);
+        const auto floor_z = std::floor(z);
+
+        const auto ix = static_cast<std::int32_t>(floor_x);
+        const auto iy = static_cast<std::int32_t>(floor_y);
+        const auto iz = static_cast<std::int32_t>(floor_z);
+
+        x -= floor_x;
+        y -= floor_y;
+        z -= floor_z;
+
+        const auto u = fade(x);
+        const auto v = fade(y);
+        const auto w = fade(z);
+
+        const auto x1 = x - 1.0f;
+        const auto y1 = y - 1.0f;
+        const auto z1 = z - 1.0f;
+
+        const auto h000 = hash(seed, ix, iy, iz);
+        const auto h100 = hash(seed, ix + 1, iy, iz);
+        const auto h010 = hash(seed, ix, iy + 1, iz);
+        const auto h110 = hash(seed, ix + 1, iy + 1, iz);
+        const auto h001 = hash(seed, ix, iy, iz + 1);
+        const auto h101 = hash(seed, ix + 1, iy, iz + 1);
+        const auto h011 = hash(seed, ix, iy + 1, iz + 1);
+        const auto h111 = hash(seed, ix + 1, iy + 1, iz + 1);
+
+        const auto n000 = grad(h000, x, y, z);
+        const auto n100 = grad(h100, x1, y, z);
+        const auto n010 = grad(h010, x, y1, z);
+        const auto n110 = grad(h110, x1, y1, z);
+        const auto n001 = grad(h001, x, y, z1);
+        const auto n101 = grad(h101, x1, y, z1);
+        const auto n011 = grad(h011, x, y1, z1);
+        const auto n111 = grad(h111, x1, y1, z1);
+
+        const auto blend = [&](const float c000, const float c100, const float c010, const float c110,
+                               const float c001, const float c101, const float c011, const float c111) {
+            return lerp(w,
+                        lerp(v, lerp(u, c000, c100), lerp(u, c010, c110)),
+                        lerp(v, lerp(u, c001, c101), lerp(u, c011, c111)));
+        };
+
+        // The gradient vectors, recovered by evaluating grad() along each axis
+        const auto axis = [&](const float ex, const float ey, const float ez) {
+            return blend(grad(h000, ex, ey, ez), grad(h100, ex, ey, ez),
+                         grad(h010, ex, ey, ez), grad(h110, ex, ey, ez),
+                         grad(h001, ex, ey, ez), grad(h101, ex, ey, ez),
+                         grad(h011, ex, ey, ez), grad(h111, ex, ey, ez));
+        };
+
+        const auto du = fade_derivative(x);
+        const auto dv = fade_derivative(y);
+        const auto dw = fade_derivative(z);
+
+        const auto k1 = n100 - n000;
+        const auto k2 = n010 - n000;
+        const auto k3 = n001 - n000;
+        const auto k4 = n000 - n100 - n010 + n110;
+        const auto k5 = n000 - n010 - n001 + n011;
+        const auto k6 = n000 - n100 - n001 + n101;
+        const auto k7 = n100 - n000 + n010 - n110 + n001 - n101 - n011 + n111;
+
+        Gradient3 result;
+        result.value = blend(n000, n100, n010, n110, n001, n101, n011, n111);
+        result.dx = axis(1.0f, 0.0f, 0.0f) + du * (k1 + k4 * v + k6 * w + k7 * (v * w));
+        result.dy = axis(0.0f, 1.0f, 0.0f) + dv * (k2 + k5 * w + k4 * u + k7 * (w * u));
+        result.dz = axis(0.0f, 0.0f, 1.0f) + dw * (k3 + k6 * u + k5 * v + k7 * (u * v));
+        return result;
+    }
+
+    static Gradient2 perlin2_gradient(const std::int32_t seed, float x, float y)
+    {
+        const auto floor_x = std::floor(x);
+        const auto floor_y = std::floor(y);
+
+        const auto ix = static_cast<std::int32_t>(floor_x);
+        const auto iy = static_cast<std::int32_t>(floor_y);
+
+        x -= floor_x;
+        y -= floor_y;
+
+        const auto u = fade(x);
+        const auto v = fade(y);
+
+        const auto x1 = x - 1.0f;
+        const auto y1 = y - 1.0f;
+
+        const auto h00 = hash(seed, ix, iy);
+        const auto h10 = hash(seed, ix + 1, iy);
+        const auto h01 = hash(seed, ix, iy + 1);
+        const auto h11 = hash(seed, ix + 1, iy + 1);
+
+        const auto n00 = grad2(h00, x, y);
+        const auto n10 = grad2(h10, x1, y);
+        const auto n01 = grad2(h01, x, y1);
+        const auto n11 = grad2(h11, x1, y1);
+
+        const auto axis = [&](const float ex, const float ey) {
+            return lerp(v,
+                        lerp(u, grad2(h00, ex, ey), grad2(h10, ex, ey)),
+                        lerp(u, grad2(h01, ex, ey), grad2(h11, ex, ey)));
+        };
+
+        const auto du = fade_derivative(x);
+        const auto dv = fade_derivative(y);
+
+        const auto k1 = n10 - n00;
+        const auto k2 = n01 - n00;
+        const auto k4 = n00 - n10 - n01 + n11;
+
+        Gradient2 result;
+        result.value = lerp(v, lerp(u, n00, n10), lerp(u, n01, n11)) * perlin2_range;
+        result.dx = (axis(1.0f, 0.0f) + du * (k1 + k4 * v)) * perlin2_range;
+        result.dy = (axis(0.0f, 1.0f) + dv * (k2 + k4 * u)) * perlin2_range;
+        return result;
+    }
+
+    static Gradient2 simplex2_gradient(const std::int32_t seed, const float x, const float y)
+    {
+        constexpr auto skew = 0.36602540378f;
+        constexpr auto unskew = 0.21132486540f;
+
+        const auto s = (x + y) * skew;
+        const auto cell_i = std::floor(x + s);
+        const auto cell_j = std::floor(y + s);
+
+        const auto t = (cell_i + cell_j) * unskew;
+        const auto x0 = x - (cell_i - t);
+        const auto y0 = y - (cell_j - t);
+
+        const auto lower = y0 < x0;
+        const auto x1 = (x0 - (lower ? 1.0f : 0.0f)) + unskew;
+        const auto y1 = (y0 - (lower ? 0.0f : 1.0f)) + unskew;
+        const auto x2 = (x0 - 1.0f) + 2.0f * unskew;
+        const auto y2 = (y0 - 1.0f) + 2.0f * unskew;
+
+        const auto ii = static_cast<std::int32_t>(cell_i);
+        const auto jj = static_cast<std::int32_t>(cell_j);
+
+        const auto c0 = simplex2_corner(hash(seed, ii, jj), x0, y0);
+        const auto c1 = simplex2_corner(hash(seed, ii + (lower ? 1 : 0), jj + (lower ? 0 : 1)), x1, y1);
+        const auto c2 = simplex2_corner(hash(seed, ii + 1, jj + 1), x2, y2);
+
+        Gradient2 result;
+        result.value = (c0.value + c1.value + c2.value) * 40.0f;
+        result.dx = (c0.dx + c1.dx + c2.dx) * 40.0f;
+        result.dy = (c0.dy + c1.dy + c2.dy) * 40.0f;
+        return result;
+    }
+
+    // Channel c of NoiseBatch::perlin2_channels. Every channel shares the
+    // lattice cell and rehashes its corners; channel 0 is perlin2.
+    static float perlin2_channel(const std::int32_t seed, float x, float y, const std::uint32_t channel)
+    {
+        const auto floor_x = std::floor(x);
+        const auto floor_y = std::floor(y);
+
+        const auto ix = static_cast<std::int32_t>(floor_x);
+        const auto iy = static_cast<std::int32_t>(floor_y);
+
+        x -= floor_x;
+        y -= floor_y;
+
+        const auto u = fade(x);
+        const auto v = fade(y);
+
+        const auto x1 = x - 1.0f;
+        const auto y1 = y - 1.0f;
+
+        const auto n00 = grad2(channel_hash(hash(seed, ix, iy), channel), x, y);
+        const auto n10 = grad2(channel_hash(hash(seed, ix + 1, iy), channel), x1, y);
+        const auto n01 = grad2(channel_hash(hash(seed, ix, iy + 1), channel), x, y1);
+        const auto n11 = grad2(channel_hash(hash(seed, ix + 1, iy + 1), channel), x1, y1);
+
+        return lerp(v, lerp(u, n00, n10), lerp(u, n01, n11)) * perlin2_range;
+    }
+
+private:
+    // 1 / (sqrt(5) * sqrt(0.5)) bounds perlin2 to [-1, 1]
+    static constexpr float perlin2_range = 0.63245553f;
+
+    static std::uint32_t prime(const std::int32_t coordinate, const std::int32_t prime)
+    {
+        return static_cast<std::uint32_t>(coordinate) * static_cast<std::uint32_t>(prime);
+    }
+
+    static std::uint32_t finish(const std::int32_t seed, const std::uint32_t h)
+    {
+        const auto mixed = (h ^ static_cast<std::uint32_t>(seed)) * static_cast<std::uint32_t>(MIX);
+        return mixed ^ (mixed >> 15);
+    }
+
+    static float fade(const float t)
+    {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    static float fade_derivative(const float t)
+    {
+        const auto t1 = t - 1.0f;
+        return 30.0f * (t * t) * t1 * t1;
+    }
+
+    static float lerp(const float t, const float a, const float b)
+    {
+        return a + t * (b - a);
+    }
+
+    static float grad(const std::uint32_t hash, const float x, const float y, const float z)
+    {
+        const auto h = hash & 15;
+        const auto u = h < 8 ? x : y;
+        const auto v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+        return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+    }
+
+    static float grad2(const std::uint32_t hash, const float x, const float y)
+    {
+        const auto h = hash & 7;
+        const auto u = h < 4 ? x : y;
+        const auto v = h < 4 ? y : x;
+        return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v + v : -(v + v));
+    }
+
+    static std::uint32_t channel_hash(const std::uint32_t hash, const std::uint32_t channel)
+    {
+        if(channel == 0) {
+            return hash;
+        }
+        return ((hash ^ (channel * 0x9E3779B9u)) * static_cast<std::uint32_t>(MIX)) >> 16;
+    }
+
+    static Gradient2 simplex2_corner(const std::uint32_t hash, const float x, const float y)
+    {
+        auto a = 0.5f - (x * x + y * y);
+        a = a > 0.0f ? a : 0.0f;
+        const auto a2 = a * a;
+        const auto a4 = a2 * a2;
+        const auto g = grad2(hash, x, y);
+
+        const auto falloff = 8.0f * (a2 * a) * g;
+
+        Gradient2 result;
+        result.value = a4 * g;
+        result.dx = a4 * grad2(hash, 1.0f, 0.0f) - falloff * x;
+        result.dy = a4 * grad2(hash, 0.0f, 1.0f) - falloff * y;
+        return result;
+    }
+};
@@ -2,12 +2,15 @@
 
 #include "glad/glad.h"
 #include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
 
 #include "../shaders/mvm.vert"
 #include "../shaders/mvm.frag"
 #include "../shaders/light_mvm.vert"
 #include "../shaders/light_mvm.frag"
 #include "../shaders/terrain.vert"
+#include "../shaders/terrain_lod.vert"
+#include "../shaders/terrain_pulled.vert"
 #include "../shaders/terrain.frag"
 
 namespace Shaders {
@@ -25,6 +28,16 @@ namespace Shaders {
         static constexpr std::string_view Vert = TerrainVert;
         static constexpr std::string_view Frag = TerrainFrag;
     };
+
+    struct TerrainLod {
+        static constexpr std::string_view Vert = TerrainLodVert;
+        static constexpr std::string_view Frag = TerrainFrag;
+    };
+
+    struct TerrainPulled {
+        static constexpr std::string_view Vert = TerrainPulledVert;
+        static constexpr std::string_view Frag = TerrainFrag;
+    };
 }
 
 class Shader {
@@ -49,7 +62,9 @@ public:
     void set_int(const char *name, int value) const;
     void set_float(const char *name, float value) const;
     void set_vec2(const char *name, const glm::vec2 &value) const;
+    void set_ivec2(const char *name, const glm::ivec2 &value) const;
     void set_vec3(const char *name, const glm::vec3 &value) const;
+    void set_vec3_array(const char *name, const glm::vec3 *values, std::size_t count) const;
     void set_vec4(const char *name, const glm::vec4 &value) const;
     void set_mat2(const char *name, const glm::mat2 &mat) const;
     void set_mat3(const char *name, const glm::mat3 &mat) const;
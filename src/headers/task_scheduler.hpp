@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque, takes its own work
+// from the back and steals from the front of the others once it runs dry.
+// The thread that submits work helps run it until the batch is finished,
+// so a scheduler without workers is just a plain loop.
+class TaskScheduler {
+public:
+    // Shared pool using every core: one worker per hardware thread besides
+    // the caller
+    static TaskScheduler& instance();
+
+    explicit TaskScheduler(unsigned int t_workers);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Workers plus the submitting thread
+    unsigned int thread_count() const {
+        return static_cast<unsigned int>(workers.size()) + 1;
+    }
+
+    // Index below thread_count() of the calling thread: a worker's own, the
+    // last one for every other thread. Threads outside the pool only run
+    // tasks of their own batches, so state kept by index is safe as long as
+    // only one outside thread uses it, as with a ScratchArena.
+    std::size_t thread_index() const {
+        return current_queue();
+    }
+
+    // Runs body(i) for every i < count and returns once all of them have
+    // finished. Tasks may call parallel_for themselves. The first exception
+    // thrown by a task is rethrown here after the rest have run.
+    template <typename F>
+    void parallel_for(std::size_t count, F&& body) {
+        if(count == 1 || workers.empty()) {
+            for(std::size_t i = 0; i < count; i++) {
+                body(i);
+            }
+            return;
+        }
+
+        // body outlives the batch, so tasks call it through a plain pointer
+        // rather than a std::function that might allocate
+        using Body = std::remove_reference_t<F>;
+        if(count > 0) {
+            run(count, &body, [](const void* target, std::size_t i) {
+                (*static_cast<Body*>(const_cast<void*>(target)))(i);
+            });
+        }
+    }
+
+private:
+    using Invoke = void (*)(const void* body, std::size_t index);
+
+    struct Batch {
+        const void* body;
+        Invoke invoke;
+        std::atomic<std::size_t> remaining;
+        // Tasks not taken off the queues yet
+        std::atomic<std::size_t> queued;
+        // Submitted from outside the pool
+        bool external;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        Batch* batch;
+        std::size_t index;
+    };
+
+    // Ring buffer of tasks. It only ever grows, so once it has held the
+    // largest batch, queueing work doesn't allocate.
+    struct Queue {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        std::size_t head = 0;
+        std::size_t size = 0;
+
+        void push_back(const Task& task);
+        const Task& front() const;
+        const Task& back() const;
+        Task pop_back();
+        Task pop_front();
+    };
+
+    void run(std::size_t count, const void* body, Invoke invoke);
+    void worker_loop(std::size_t queue);
+
+    // Pops from the back of the given queue, otherwise steals from the front
+    // of the others. With only set, just tasks of that batch are taken.
+    bool find_task(std::size_t queue, Task& task, const Batch* only);
+    void execute(const Task& task);
+
+    // Queue used by the calling thread: its own for workers, the shared last
+    // one for everyone else
+    std::size_t current_queue() const;
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<std::size_t> queued;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool stopping;
+};
@@ -0,0 +1,994 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "culling.hpp"
+#include "drawable.hpp"
+#include "grid_indices.hpp"
+#include "scratch_arena.hpp"
+#include "shader.hpp"
+#include "task_scheduler.hpp"
+#include "terrain_squares.hpp"
+
+// Node of the chunk quadtree. A chunk of level L spans chunk_cells << L
+// cells along the vertex x and z axes, with x and z counted in chunks of
+// its own level.
+struct ChunkKey {
+    int level;
+    int x;
+    int z;
+
+    bool operator==(const ChunkKey& other) const {
+        return level == other.level && x == other.x && z == other.z;
+    }
+};
+
+struct ChunkStats {
+    // Chunks in video memory, and how many of them are drawn
+    std::size_t resident;
+    std::size_t drawn;
+    // Chunk meshes kept in memory
+    std::size_t cached;
+    // Chunks waiting to be generated
+    std::size_t queued;
+    std::size_t cpu_bytes;
+    std::size_t gpu_bytes;
+};
+
+// A chunk vertex along with what it turns into as its chunk blends into the
+// next coarser level: vertices at odd samples slide onto the even one before
+// them and take on its height, normal and colour
+struct ChunkVertex {
+    Vertex vertex;
+    Vertex target;
+};
+
+using ChunkVertexData = std::vector<ChunkVertex>;
+
+// Runs of the shared element buffer that draw some of a chunk's quadrants
+struct QuadrantRuns {
+    VertexPrimitive primitive;
+    VertexDataType type;
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+};
+
+// One chunk's vertices in video memory. The chunks all have the same
+// layout, so they share one element buffer.
+class TerrainChunk : public Drawable<TerrainChunk> {
+public:
+    explicit TerrainChunk(
+        VertexArrayObject&& t_vao,
+        VertexBufferObject&& t_vbo
+    ) : Drawable(std::move(t_vao)),
+        vbo(std::move(t_vbo)),
+        runs(nullptr)
+    {
+    }
+
+    static std::shared_ptr<TerrainChunk> create_impl(const VertexBufferObject& ebo, const ChunkVertexData& vertices) {
+        auto chunk_vao = VertexArrayObject();
+        auto chunk_vbo = VertexBufferObject(VertexBufferType::ARRAY);
+
+        chunk_vao.bind();
+
+        chunk_vbo.bind();
+        chunk_vbo.send_data(vertices, VertexDrawType::DYNAMIC);
+
+        TerrainSquares::enable_vertex_attributes(chunk_vbo, 0, 2, 0);
+        TerrainSquares::enable_vertex_attributes(chunk_vbo, 3, 2, 1);
+
+        ebo.bind();
+
+        chunk_vbo.unbind();
+        chunk_vao.unbind();
+
+        return std::make_shared<TerrainChunk>(std::move(chunk_vao), std::move(chunk_vbo));
+    }
+
+    // Replaces the vertices, orphaning the old storage, so a buffer is
+    // reused for the next chunk without waiting on draws of the last one
+    void update_impl(const ChunkVertexData& vertices) {
+        vao.bind();
+        vbo.bind();
+        vbo.update_data(vertices);
+        vbo.unbind();
+        vao.unbind();
+    }
+
+    // Quadrants drawn from now on
+    void show(const QuadrantRuns& t_runs) {
+        runs = &t_runs;
+    }
+
+    DrawType draw_impl() {
+        vao.bind();
+
+        auto draw_type = MultiDrawElements {
+            runs->primitive,
+            runs->counts,
+            runs->type,
+            runs->offsets
+        };
+
+        return DrawType(draw_type);
+    }
+
+private:
+    VertexBufferObject vbo;
+    const QuadrantRuns* runs;
+};
+
+// Endless terrain streamed around the camera as a quadtree of chunks with
+// continuous levels of detail (CDLOD). Every chunk is a grid of
+// chunk_cells x chunk_cells cells, sampled chunk_cells apart whatever its
+// level, so chunks twice as far away are twice as coarse and the number of
+// triangles drawn stays about the same however far the terrain reaches.
+//
+// A chunk of level L is split into its four children within lod_range(L - 1)
+// of the camera. Quadrants left unsplit are drawn from the parent through
+// the shared element buffer, whose triangles are ordered by quadrant. Over
+// the last quarter of its range a chunk's vertices blend into the coarser
+// grid, so where two levels meet the finer one has fully turned into the
+// coarser and the mesh has no cracks.
+//
+// Chunks are generated on a background thread, nearest first, and kept in
+// memory and video memory within their own budgets. A chunk is only split
+// once its children are in video memory, so the terrain coarsens rather
+// than showing holes while they are generated.
+//
+// Heights are always normalised over the analytic range and the stages
+// only depend on world positions, so chunks agree exactly on the samples
+// they share, including those of neighbouring levels.
+class TerrainChunks {
+public:
+    TerrainChunks(
+        const unsigned int t_chunk_cells,
+        const std::size_t t_cpu_budget,
+        const std::size_t t_gpu_budget,
+        const IndexOptions index_options = GridIndices::default_options)
+        : chunk_cells(t_chunk_cells),
+          ebo(VertexBufferType::ELEMENT),
+          index_type(GridIndices::index_type(std::size_t(t_chunk_cells + 1) * (t_chunk_cells + 1), index_options.primitive)),
+          cpu_budget(t_cpu_budget),
+          gpu_budget(t_gpu_budget),
+          generation(0),
+          frame(0),
+          top_level(0),
+          stats_of_cull{0, 0, 0},
+          cpu_bytes(0),
+          gpu_chunks(0),
+          latest_generation(0),
+          stopping(false)
+    {
+        if (chunk_cells < 2 || chunk_cells % 2 != 0) {
+            throw std::runtime_error("Chunks need an even number of cells to be split into quadrants");
+        }
+
+        // Bound to each chunk's vertex array when it is created
+        const auto indices = chunk_indices(chunk_cells, index_options);
+        std::vector<std::uint16_t> narrowed;
+        ebo.bind();
+        ebo.send_indices(indices, index_type, VertexDrawType::STATIC, narrowed);
+        ebo.unbind();
+        index_count = indices.size();
+
+        const auto quadrant_count = static_cast<GLsizei>(index_count / 4);
+        for (unsigned int mask = 0; mask < quadrant_runs.size(); mask++) {
+            quadrant_runs[mask].primitive = index_options.primitive;
+            quadrant_runs[mask].type = index_type;
+            for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+                if ((mask & (1u << quadrant)) == 0) {
+                    continue;
+                }
+
+                // Neighbouring quadrants are drawn as one run
+                auto& runs = quadrant_runs[mask];
+                if (quadrant > 0 && (mask & (1u << (quadrant - 1)))) {
+                    runs.counts.back() += quadrant_count;
+                } else {
+                    runs.counts.push_back(quadrant_count);
+                    runs.offsets.push_back(reinterpret_cast<const void *>(quadrant * quadrant_count * type_size(index_type)));
+                }
+            }
+        }
+
+        worker = std::thread([this] { generation_loop(); });
+    }
+
+    ~TerrainChunks() {
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            stopping = true;
+            latest_generation++;
+        }
+        jobs_ready.notify_one();
+        worker.join();
+    }
+
+    TerrainChunks(const TerrainChunks&) = delete;
+    TerrainChunks& operator=(const TerrainChunks&) = delete;
+
+    static constexpr unsigned int default_chunk_cells = 64;
+    static constexpr std::size_t default_cpu_budget = 256 << 20;
+    static constexpr std::size_t default_gpu_budget = 256 << 20;
+
+    // Uploads are spread over frames so a burst of finished chunks doesn't
+    // stall one
+    static constexpr unsigned int uploads_per_frame = 4;
+
+    // Levels of detail reach this many chunk widths of their own level, and
+    // blend into the next level over the last quarter of that
+    static constexpr float range_chunks = 3.0f;
+    static constexpr float morph_start = 0.75f;
+
+    static constexpr int max_level = 16;
+
+    // Call once a frame on the render thread, before draw. Picks the chunks
+    // to draw within view_distance of position, uploads the nearest
+    // finished ones and hands the rest, nearest first, to the generation
+    // thread. Chunks of older settings are drawn until their replacements
+    // are uploaded.
+    void update(const GenerationSettings& settings, const glm::vec3& position, const float view_distance) {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (generation_error) {
+                std::rethrow_exception(std::exchange(generation_error, nullptr));
+            }
+        }
+
+        frame++;
+        if (generation == 0 || !same_chunk_inputs(generated_settings, settings)) {
+            generated_settings = settings;
+            generation++;
+            latest_generation = generation;
+            drop_stale_meshes();
+        }
+
+        take_finished();
+        choose_wanted(glm::vec2(position.x, position.z), view_distance);
+        upload_wanted();
+        trim_gpu();
+        trim_cpu();
+        queue_missing();
+    }
+
+    // Leaves out of this frame's draw the quadrants outside the view
+    // frustum and those hidden behind nearer terrain. The boxes are in the
+    // space the shader positions vertices in, before model.
+    void cull(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camera_position, const float height_scale) {
+        const auto frustum = Frustum(projection * view * model);
+        horizon.reset(glm::vec3(glm::inverse(model) * glm::vec4(camera_position, 1.0f)));
+
+        boxes.clear();
+        for (std::size_t i = 0; i < drawn.size(); i++) {
+            const auto chunk = chunks.find(chunk_id(drawn[i].key));
+            if (chunk == chunks.end() || !chunk->second.gpu) {
+                continue;
+            }
+
+            const auto extent = chunk_extent(drawn[i].key.level);
+            for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+                if ((drawn[i].quadrants & (1u << quadrant)) == 0) {
+                    continue;
+                }
+
+                const auto& bounds = chunk->second.gpu_bounds[quadrant];
+                const auto corner = glm::vec2(drawn[i].key.x + 0.5f * (quadrant >> 1), drawn[i].key.z + 0.5f * (quadrant & 1)) * extent;
+                const auto box = BoundingBox {
+                    glm::vec3(corner.x, bounds.heights.x * height_scale, corner.y),
+                    glm::vec3(corner.x + 0.5f * extent, bounds.heights.y * height_scale, corner.y + 0.5f * extent)
+                };
+                boxes.push_back(QuadrantBox { box, horizon.near_distance(box), i, quadrant, &bounds, corner, extent });
+            }
+        }
+
+        // The horizon is built front to back
+        std::sort(boxes.begin(), boxes.end(), [](const QuadrantBox& a, const QuadrantBox& b) {
+            return a.near < b.near;
+        });
+
+        stats_of_cull = CullStats { boxes.size(), 0, 0 };
+        for (auto& drawn_chunk : visible) {
+            drawn_chunk.quadrants = 0;
+        }
+        for (const auto& box : boxes) {
+            if (!frustum.intersects(box.box)) {
+                stats_of_cull.frustum_culled++;
+                continue;
+            }
+
+            // Its blocks are no higher than the horizon that hides it
+            if (horizon.occluded(box.box)) {
+                stats_of_cull.occluded++;
+                continue;
+            }
+
+            visible[box.drawn].quadrants |= 1u << box.quadrant;
+
+            // The quadrant's lowest point is usually in a valley, so its
+            // blocks hide what is behind them instead. Terrain outside the
+            // frustum is left out, which only ever keeps more.
+            const auto spacing = box.extent / chunk_cells;
+            for (unsigned int block = 0; block < occluder_blocks * occluder_blocks; block++) {
+                const auto x = block / occluder_blocks;
+                const auto z = block % occluder_blocks;
+                const auto first = box.corner + glm::vec2(block_start(chunk_cells, x), block_start(chunk_cells, z)) * spacing;
+                const auto last = box.corner + glm::vec2(block_start(chunk_cells, x + 1), block_start(chunk_cells, z + 1)) * spacing;
+                const auto floor = box.bounds->floors[block] * height_scale;
+                horizon.add_occluder(BoundingBox { glm::vec3(first.x, floor, first.y), glm::vec3(last.x, floor, last.y) });
+            }
+        }
+    }
+
+    // Draws the chosen chunks with a shader of Shaders::TerrainLod, which
+    // places their vertices in the world from their index
+    void draw(const Shader& shader, const glm::vec3& camera_position) {
+        shader.set_vec3("camera_position", camera_position);
+        shader.set_int("chunk_size", static_cast<int>(chunk_cells + 1));
+        for (const auto& drawn_chunk : visible) {
+            if (drawn_chunk.quadrants == 0) {
+                continue;
+            }
+
+            const auto chunk = chunks.find(chunk_id(drawn_chunk.key));
+            if (chunk == chunks.end() || !chunk->second.gpu) {
+                continue;
+            }
+
+            const auto level = drawn_chunk.key.level;
+            shader.set_vec2("chunk_corner", glm::vec2(drawn_chunk.key.x, drawn_chunk.key.z) * chunk_extent(level));
+            shader.set_float("spacing", static_cast<float>(1 << level));
+            shader.set_vec2("morph_range", morph_range(level));
+            chunk->second.gpu->show(quadrant_runs[drawn_chunk.quadrants]);
+            chunk->second.gpu->draw();
+        }
+    }
+
+    // Budgets in bytes for chunk meshes in memory and in video memory. Take
+    // effect from the next update.
+    void set_budgets(const std::size_t cpu, const std::size_t gpu) {
+        cpu_budget = cpu;
+        gpu_budget = gpu;
+    }
+
+    ChunkStats stats() const {
+        std::size_t cached = 0;
+        for (const auto& [id, chunk] : chunks) {
+            if (!chunk.mesh.empty()) {
+                cached++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(job_mutex);
+        return ChunkStats {
+            gpu_chunks,
+            drawn.size(),
+            cached,
+            jobs.size() + in_progress.size(),
+            cpu_bytes,
+            gpu_chunks * chunk_bytes() + index_count * type_size(index_type)
+        };
+    }
+
+    // Quadrants tested by the last cull and why the others were left out
+    CullStats cull_stats() const {
+        return stats_of_cull;
+    }
+
+private:
+    // Blocks along each side of a quadrant that occlude separately
+    static constexpr unsigned int occluder_blocks = 4;
+
+    // Lowest and highest vertex of a quadrant, and the lowest of each of
+    // its blocks, before the height scale
+    struct QuadrantBounds {
+        glm::vec2 heights;
+        std::array<float, occluder_blocks * occluder_blocks> floors;
+    };
+    using ChunkBounds = std::array<QuadrantBounds, 4>;
+
+    // What is known about one chunk. Generations number the settings the
+    // chunks were made with, 0 meaning none.
+    struct Chunk {
+        ChunkKey key;
+        ChunkVertexData mesh;
+        ChunkBounds mesh_bounds;
+        std::uint64_t mesh_generation = 0;
+        std::shared_ptr<TerrainChunk> gpu;
+        ChunkBounds gpu_bounds;
+        std::uint64_t gpu_generation = 0;
+        std::uint64_t last_used = 0;
+        bool wanted = false;
+        float distance = 0.0f;
+    };
+
+    // Chunk drawn this frame and which of its quadrants, one bit each
+    struct DrawnChunk {
+        ChunkKey key;
+        unsigned int quadrants;
+    };
+
+    // Chunk to generate or upload. Missing parts of the terrain come
+    // before the chunks that would refine it.
+    struct WantedChunk {
+        ChunkKey key;
+        bool refinement;
+        float distance;
+    };
+
+    // Bounds of a drawn quadrant, and where it is in drawn
+    struct QuadrantBox {
+        BoundingBox box;
+        float near;
+        std::size_t drawn;
+        unsigned int quadrant;
+        const QuadrantBounds* bounds;
+        glm::vec2 corner;
+        float extent;
+    };
+
+    // Finished chunk on its way from the generation thread
+    struct GeneratedChunk {
+        ChunkKey key;
+        std::uint64_t generation;
+        ChunkVertexData vertices;
+        ChunkBounds bounds;
+    };
+
+    static constexpr unsigned int all_quadrants = 0xf;
+
+    static std::uint64_t chunk_id(const ChunkKey& key) {
+        return (std::uint64_t(key.level) << 58) |
+               (std::uint64_t(std::uint32_t(key.x) & 0x1fffffff) << 29) |
+               (std::uint32_t(key.z) & 0x1fffffff);
+    }
+
+    // Quadrant bit 1 picks the half along x, bit 0 the half along z
+    static ChunkKey child(const ChunkKey& key, const unsigned int quadrant) {
+        return ChunkKey { key.level - 1, key.x * 2 + static_cast<int>(quadrant >> 1), key.z * 2 + static_cast<int>(quadrant & 1) };
+    }
+
+    std::size_t chunk_bytes() const {
+        return std::size_t(chunk_cells + 1) * (chunk_cells + 1) * sizeof(ChunkVertex);
+    }
+
+    float chunk_extent(const int level) const {
+        return static_cast<float>(chunk_cells) * static_cast<float>(1 << level);
+    }
+
+    float lod_range(const int level) const {
+        return range_chunks * chunk_extent(level);
+    }
+
+    // Ground distances over which chunks of a level blend into the next.
+    // The coarsest level drawn has nothing to blend into.
+    glm::vec2 morph_range(const int level) const {
+        if (level == top_level) {
+            return glm::vec2(1e30f, 2e30f);
+        }
+        return glm::vec2(morph_start * lod_range(level), lod_range(level));
+    }
+
+    // Everything but where the window is and how tall it is drawn
+    static bool same_chunk_inputs(const GenerationSettings& a, const GenerationSettings& b) {
+        auto moved = a;
+        moved.origin = b.origin;
+        moved.spacing = b.spacing;
+        return moved.same_noise_inputs(b) && moved.same_climate_inputs(b);
+    }
+
+    // Two triangles per cell over a (cells + 1)^2 grid of vertices laid out
+    // row by row, the same way as the terrain's previews, with the
+    // triangles of each quadrant together
+    static Indices chunk_indices(const unsigned int cells, const IndexOptions index_options) {
+        Indices chunk_indices;
+        const auto size = cells + 1;
+        const auto half = cells / 2;
+        for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+            const auto first_x = (quadrant >> 1) * half;
+            const auto first_z = (quadrant & 1) * half;
+            GridIndices(half, half, index_options).append(chunk_indices, [=](unsigned int x, unsigned int z) {
+                return (first_x + x) * size + first_z + z;
+            });
+        }
+
+        return chunk_indices;
+    }
+
+    // Pairs every vertex of a tile with the even vertex it blends into
+    static void add_morph_targets(const VertexData& tile, const unsigned int cells, ChunkVertexData& vertices) {
+        const auto size = cells + 1;
+        vertices.resize(tile.size());
+        for (unsigned int x = 0; x < size; x++) {
+            for (unsigned int z = 0; z < size; z++) {
+                const auto& target = tile[(x & ~1u) * size + (z & ~1u)];
+                vertices[x * size + z] = ChunkVertex { tile[x * size + z], target };
+            }
+        }
+    }
+
+    // First sample of a block along a quadrant's side, even but for the
+    // quadrant's far edge
+    static unsigned int block_start(const unsigned int cells, const unsigned int block) {
+        return block == occluder_blocks ? cells / 2 : 2 * (cells / 4 * block / occluder_blocks);
+    }
+
+    // Blending only moves vertices onto others of the same quadrant, and
+    // of the same block as the blocks start at even samples, so these bound
+    // them however far they are blended
+    static ChunkBounds chunk_bounds(const VertexData& tile, const unsigned int cells) {
+        const auto size = cells + 1;
+        const auto half = cells / 2;
+
+        ChunkBounds bounds;
+        for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+            auto& quadrant_bounds = bounds[quadrant];
+            quadrant_bounds.heights = glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+            for (unsigned int block = 0; block < occluder_blocks * occluder_blocks; block++) {
+                const auto first_x = (quadrant >> 1) * half + block_start(cells, block / occluder_blocks);
+                const auto last_x = (quadrant >> 1) * half + block_start(cells, block / occluder_blocks + 1);
+                const auto first_z = (quadrant & 1) * half + block_start(cells, block % occluder_blocks);
+                const auto last_z = (quadrant & 1) * half + block_start(cells, block % occluder_blocks + 1);
+                auto low = std::numeric_limits<float>::max();
+                auto high = std::numeric_limits<float>::lowest();
+                for (auto x = first_x; x <= last_x; x++) {
+                    for (auto z = first_z; z <= last_z; z++) {
+                        low = std::min(low, tile[x * size + z].unpacked_height());
+                        high = std::max(high, tile[x * size + z].unpacked_height());
+                    }
+                }
+
+                quadrant_bounds.floors[block] = low;
+                quadrant_bounds.heights = glm::vec2(std::min(quadrant_bounds.heights.x, low), std::max(quadrant_bounds.heights.y, high));
+            }
+        }
+
+        return bounds;
+    }
+
+    // Meshes of older settings are never shown, unlike uploaded chunks
+    void drop_stale_meshes() {
+        for (auto& [id, chunk] : chunks) {
+            if (chunk.mesh_generation != generation && !chunk.mesh.empty()) {
+                cpu_bytes -= chunk_bytes();
+                chunk.mesh = ChunkVertexData();
+                chunk.mesh_generation = 0;
+            }
+        }
+    }
+
+    void take_finished() {
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            std::swap(finished, arrived);
+        }
+
+        for (auto& result : arrived) {
+            if (result.generation != generation) {
+                continue;
+            }
+
+            auto& chunk = chunks[chunk_id(result.key)];
+            chunk.key = result.key;
+            if (chunk.mesh.empty()) {
+                cpu_bytes += chunk_bytes();
+            }
+            chunk.mesh = std::move(result.vertices);
+            chunk.mesh_bounds = result.bounds;
+            chunk.mesh_generation = generation;
+            chunk.last_used = frame;
+        }
+        arrived.clear();
+    }
+
+    // Distance along the ground from position to the nearest point of a
+    // chunk
+    float distance_to(const ChunkKey& key, const glm::vec2& position) const {
+        const auto extent = chunk_extent(key.level);
+        const auto dx = std::max({ key.x * extent - position.x, 0.0f, position.x - (key.x + 1) * extent });
+        const auto dz = std::max({ key.z * extent - position.y, 0.0f, position.y - (key.z + 1) * extent });
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    bool resident(const ChunkKey& key) const {
+        const auto chunk = chunks.find(chunk_id(key));
+        return chunk != chunks.end() && chunk->second.gpu;
+    }
+
+    // Walks the quadtree from the coarsest level that covers view_distance
+    // down to the chunks to draw, and collects those along with the
+    // children that would refine them, nearest first, as many as fit the
+    // video memory budget
+    void choose_wanted(const glm::vec2& position, const float view_distance) {
+        for (auto& [id, chunk] : chunks) {
+            chunk.wanted = false;
+        }
+
+        top_level = 0;
+        while (top_level < max_level && lod_range(top_level) < view_distance) {
+            top_level++;
+        }
+
+        const auto extent = chunk_extent(top_level);
+        const auto first_x = static_cast<int>(std::floor((position.x - view_distance) / extent));
+        const auto end_x = static_cast<int>(std::floor((position.x + view_distance) / extent));
+        const auto first_z = static_cast<int>(std::floor((position.y - view_distance) / extent));
+        const auto end_z = static_cast<int>(std::floor((position.y + view_distance) / extent));
+
+        drawn.clear();
+        wanted.clear();
+        for (auto x = first_x; x <= end_x; x++) {
+            for (auto z = first_z; z <= end_z; z++) {
+                const auto key = ChunkKey { top_level, x, z };
+                if (distance_to(key, position) <= view_distance) {
+                    select(key, position);
+                }
+            }
+        }
+
+        std::stable_sort(wanted.begin(), wanted.end(), [](const WantedChunk& a, const WantedChunk& b) {
+            if (a.refinement != b.refinement) {
+                return !a.refinement;
+            }
+            return a.distance < b.distance;
+        });
+
+        // A chunk standing in for its parent is wanted twice
+        const auto capacity = gpu_capacity();
+        std::size_t kept = 0;
+        for (const auto& wanted_chunk : wanted) {
+            auto& chunk = chunks[chunk_id(wanted_chunk.key)];
+            if (chunk.wanted || kept == capacity) {
+                continue;
+            }
+            chunk.key = wanted_chunk.key;
+            chunk.wanted = true;
+            wanted[kept++] = wanted_chunk;
+        }
+        wanted.resize(kept);
+
+        // Distances of the rest decide what is evicted first
+        for (auto& [id, chunk] : chunks) {
+            chunk.distance = distance_to(chunk.key, position);
+        }
+
+        // Everything is drawn until culled
+        visible = drawn;
+    }
+
+    // Splits a chunk into the children within range of the next finer level
+    // once they are all in video memory, and draws the rest of its
+    // quadrants itself
+    void select(const ChunkKey& key, const glm::vec2& position) {
+        if (key.level == 0 || distance_to(key, position) > lod_range(key.level - 1)) {
+            add_drawn(key, all_quadrants, position);
+            return;
+        }
+
+        unsigned int split = 0;
+        auto ready = true;
+        for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+            const auto quadrant_key = child(key, quadrant);
+            if (distance_to(quadrant_key, position) <= lod_range(key.level - 1)) {
+                split |= 1u << quadrant;
+                ready = ready && resident(quadrant_key);
+            }
+        }
+
+        if (!ready) {
+            add_drawn(key, all_quadrants, position);
+            for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+                if (split & (1u << quadrant)) {
+                    const auto quadrant_key = child(key, quadrant);
+                    wanted.push_back(WantedChunk { quadrant_key, true, distance_to(quadrant_key, position) });
+                }
+            }
+            return;
+        }
+
+        for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+            if (split & (1u << quadrant)) {
+                select(child(key, quadrant), position);
+            }
+        }
+
+        if (split != all_quadrants) {
+            add_drawn(key, all_quadrants & ~split, position);
+        }
+    }
+
+    // Until a chunk is in video memory its children stand in for it when
+    // they are, fully blended into its level
+    void add_drawn(const ChunkKey& key, const unsigned int quadrants, const glm::vec2& position) {
+        wanted.push_back(WantedChunk { key, false, distance_to(key, position) });
+        if (!resident(key) && key.level > 0) {
+            auto children_resident = true;
+            for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+                if (quadrants & (1u << quadrant)) {
+                    children_resident = children_resident && resident(child(key, quadrant));
+                }
+            }
+
+            if (children_resident) {
+                for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+                    if (quadrants & (1u << quadrant)) {
+                        const auto quadrant_key = child(key, quadrant);
+                        drawn.push_back(DrawnChunk { quadrant_key, all_quadrants });
+                        wanted.push_back(WantedChunk { quadrant_key, false, distance_to(quadrant_key, position) });
+                    }
+                }
+                return;
+            }
+        }
+
+        drawn.push_back(DrawnChunk { key, quadrants });
+    }
+
+    std::size_t gpu_capacity() const {
+        return gpu_budget.load() / chunk_bytes();
+    }
+
+    // Sends the first wanted meshes that aren't uploaded yet to video
+    // memory, reusing the buffers of chunks no longer wanted once the
+    // budget is used up
+    void upload_wanted() {
+        unsigned int uploads = 0;
+        for (const auto& wanted_chunk : wanted) {
+            if (uploads == uploads_per_frame) {
+                break;
+            }
+
+            auto& chunk = chunks[chunk_id(wanted_chunk.key)];
+            if (chunk.gpu_generation == generation || chunk.mesh_generation != generation) {
+                continue;
+            }
+
+            if (!chunk.gpu) {
+                if (gpu_chunks < gpu_capacity()) {
+                    chunk.gpu = TerrainChunk::create(ebo, chunk.mesh);
+                    gpu_chunks++;
+                } else {
+                    auto victim = furthest_unwanted_gpu();
+                    if (!victim) {
+                        break;
+                    }
+                    chunk.gpu = std::move(victim->gpu);
+                    victim->gpu_generation = 0;
+                    chunk.gpu->update(chunk.mesh);
+                }
+            } else {
+                chunk.gpu->update(chunk.mesh);
+            }
+
+            chunk.gpu_bounds = chunk.mesh_bounds;
+            chunk.gpu_generation = generation;
+            chunk.last_used = frame;
+            uploads++;
+        }
+    }
+
+    Chunk* furthest_unwanted_gpu() {
+        Chunk* furthest = nullptr;
+        for (auto& [id, chunk] : chunks) {
+            if (chunk.gpu && !chunk.wanted && (!furthest || chunk.distance > furthest->distance)) {
+                furthest = &chunk;
+            }
+        }
+
+        return furthest;
+    }
+
+    // Frees the video memory of the furthest chunks while over budget
+    void trim_gpu() {
+        while (gpu_chunks > gpu_capacity()) {
+            Chunk* furthest = nullptr;
+            for (auto& [id, chunk] : chunks) {
+                if (chunk.gpu && (!furthest || chunk.distance > furthest->distance)) {
+                    furthest = &chunk;
+                }
+            }
+
+            furthest->gpu.reset();
+            furthest->gpu_generation = 0;
+            gpu_chunks--;
+        }
+    }
+
+    // Meshes that still have to be uploaded stay; of the others, those not
+    // wanted go first, least recently used first, then the furthest ones
+    // that are already uploaded
+    void trim_cpu() {
+        if (cpu_bytes > cpu_budget.load()) {
+            evictable.clear();
+            for (auto& [id, chunk] : chunks) {
+                const auto in_transit = chunk.wanted && chunk.gpu_generation != generation;
+                if (!chunk.mesh.empty() && !in_transit) {
+                    evictable.push_back(&chunk);
+                }
+            }
+
+            std::sort(evictable.begin(), evictable.end(), [](const Chunk* a, const Chunk* b) {
+                if (a->wanted != b->wanted) {
+                    return !a->wanted;
+                }
+                return a->wanted ? a->distance > b->distance : a->last_used < b->last_used;
+            });
+
+            for (auto chunk : evictable) {
+                if (cpu_bytes <= cpu_budget.load()) {
+                    break;
+                }
+                chunk->mesh = ChunkVertexData();
+                chunk->mesh_generation = 0;
+                cpu_bytes -= chunk_bytes();
+            }
+        }
+
+        for (auto chunk = chunks.begin(); chunk != chunks.end();) {
+            if (!chunk->second.wanted && !chunk->second.gpu && chunk->second.mesh.empty()) {
+                chunk = chunks.erase(chunk);
+            } else {
+                chunk++;
+            }
+        }
+    }
+
+    // Hands the wanted chunks that have neither a mesh nor an upload to the
+    // generation thread, in order and only as many as there is memory for,
+    // replacing its earlier queue
+    void queue_missing() {
+        const auto budget = cpu_budget.load();
+        auto room = budget > cpu_bytes ? (budget - cpu_bytes) / chunk_bytes() : 0;
+
+        std::lock_guard<std::mutex> lock(job_mutex);
+        const auto pending = [&](const ChunkKey& key) {
+            return std::find(in_progress.begin(), in_progress.end(), key) != in_progress.end() ||
+                   std::any_of(finished.begin(), finished.end(), [&](const GeneratedChunk& result) { return result.key == key; });
+        };
+
+        jobs.clear();
+        for (const auto& wanted_chunk : wanted) {
+            const auto& chunk = chunks[chunk_id(wanted_chunk.key)];
+            if (chunk.mesh_generation == generation || chunk.gpu_generation == generation || pending(wanted_chunk.key)) {
+                continue;
+            }
+            if (room == 0) {
+                break;
+            }
+            jobs.push_back(wanted_chunk.key);
+            room--;
+        }
+
+        job_settings = generated_settings;
+        job_generation = generation;
+        if (!jobs.empty()) {
+            jobs_ready.notify_one();
+        }
+    }
+
+    // Generates the queued chunks in batches of one per scheduler thread.
+    // Each slot keeps its own maps, so after the first batch generating
+    // only allocates the meshes handed over. Heights are always normalised
+    // over the analytic range, so a chunk doesn't depend on its neighbours.
+    void generation_loop() {
+        const auto slots = TaskScheduler::instance().thread_count();
+        std::vector<GenerationCache> caches;
+        for (unsigned int i = 0; i < slots; i++) {
+            caches.push_back(TerrainSquares::empty_cache(chunk_cells + 2, scratch_arena));
+        }
+        std::vector<TilePlacement> placements;
+        std::vector<VertexData> tiles(slots);
+        std::vector<char> complete(slots);
+        std::vector<GeneratedChunk> done;
+
+        std::unique_lock<std::mutex> lock(job_mutex);
+        while (true) {
+            jobs_ready.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            const auto count = std::min<std::size_t>(jobs.size(), slots);
+            in_progress.assign(jobs.begin(), jobs.begin() + count);
+            jobs.erase(jobs.begin(), jobs.begin() + count);
+            auto settings = job_settings;
+            settings.height_range = HeightRange::ANALYTIC;
+            const auto chunk_generation = job_generation;
+            lock.unlock();
+
+            // Vertex x runs along the map's rows (y) and z along its
+            // columns. A chunk's origin is the same in samples of its own
+            // level whatever the level.
+            const auto cells = static_cast<int>(chunk_cells);
+            placements.clear();
+            for (const auto& key : in_progress) {
+                placements.push_back(TilePlacement { glm::ivec2(key.z * cells, key.x * cells), 1 << key.level });
+            }
+
+            try {
+                TerrainSquares::generate_tiles(caches, chunk_cells, settings, placements, CancelToken { &latest_generation, chunk_generation }, tiles, complete);
+            } catch (...) {
+                std::fill(complete.begin(), complete.end(), false);
+                std::lock_guard<std::mutex> error_lock(error_mutex);
+                generation_error = std::current_exception();
+            }
+
+            // The render thread takes the lock every frame, so the chunks are
+            // built before it is taken again
+            done.clear();
+            for (std::size_t i = 0; i < count; i++) {
+                if (complete[i]) {
+                    done.push_back(GeneratedChunk { in_progress[i], chunk_generation, ChunkVertexData(), chunk_bounds(tiles[i], chunk_cells) });
+                    add_morph_targets(tiles[i], chunk_cells, done.back().vertices);
+                }
+            }
+
+            lock.lock();
+            std::move(done.begin(), done.end(), std::back_inserter(finished));
+            in_progress.clear();
+        }
+    }
+
+    const unsigned int chunk_cells;
+    VertexBufferObject ebo;
+    VertexDataType index_type;
+    std::size_t index_count;
+    std::array<QuadrantRuns, all_quadrants + 1> quadrant_runs;
+
+    std::atomic<std::size_t> cpu_budget;
+    std::atomic<std::size_t> gpu_budget;
+
+    // Render thread state
+    GenerationSettings generated_settings;
+    std::uint64_t generation;
+    std::uint64_t frame;
+    int top_level;
+    std::unordered_map<std::uint64_t, Chunk> chunks;
+    std::vector<DrawnChunk> drawn;
+    std::vector<DrawnChunk> visible;
+    std::vector<QuadrantBox> boxes;
+    HorizonBuffer horizon;
+    CullStats stats_of_cull;
+    std::vector<WantedChunk> wanted;
+    std::vector<Chunk*> evictable;
+    std::vector<GeneratedChunk> arrived;
+    std::size_t cpu_bytes;
+    std::size_t gpu_chunks;
+
+    // Shared with the generation thread
+    mutable std::mutex job_mutex;
+    std::condition_variable jobs_ready;
+    std::vector<ChunkKey> jobs;
+    std::vector<ChunkKey> in_progress;
+    std::vector<GeneratedChunk> finished;
+    GenerationSettings job_settings;
+    std::uint64_t job_generation;
+    std::atomic<std::uint64_t> latest_generation;
+    bool stopping;
+
+    std::mutex error_mutex;
+    std::exception_ptr generation_error;
+
+    // Scratch of the generation thread's stages
+    ScratchArena scratch_arena;
+
+    std::thread worker;
+};
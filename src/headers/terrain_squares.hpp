@@ -1,14 +1,45 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <limits>
+#include <mutex>
 #include <random>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include "glm/glm.hpp"
 
+#include "biomes.hpp"
 #include "drawable.hpp"
-#include "perlin.hpp"
+#include "grid_indices.hpp"
+#include "noise_graphs.hpp"
+#include "octave_layer_cache.hpp"
+#include "rtin.hpp"
+#include "scratch_arena.hpp"
+#include "shader.hpp"
+#include "task_scheduler.hpp"
+#include "tiled_grid.hpp"
+
+// What the heights are normalised over before they become vertices
+enum class HeightRange {
+    // The lowest and highest height generated so far. Uses every colour
+    // band, but a sample's height depends on the rest of the window.
+    OBSERVED,
+    // The bounds of the octave sum, from the octave count and persistence.
+    // A sample's height only depends on its world position, so any part of
+    // the terrain can be generated on its own and still line up.
+    ANALYTIC
+};
 
 struct GenerationSettings {
     int seed;
@@ -18,6 +49,26 @@ struct GenerationSettings {
     float persistence; 
     float lacunarity; 
     glm::vec2 offset;
+    NoiseType noise_type;
+    LatticeHash lattice_hash;
+    float warp_strength;
+    float warp_scale;
+
+    // Window position in whole samples. Unlike offset, which shifts every
+    // octave by the same amount in its own frequency, moving the origin
+    // translates the whole terrain.
+    glm::ivec2 origin;
+
+    // World cells between neighbouring samples. Coarser levels of detail
+    // sample the same terrain further apart; the origin stays in samples.
+    int spacing;
+
+    HeightRange height_range;
+
+    // Largest height error, at a height scale of 1, the full resolution mesh
+    // may be drawn with by merging cells into larger triangles. 0 draws
+    // every cell.
+    float mesh_error;
 
     // Defaults
     GenerationSettings() 
@@ -27,7 +78,15 @@ struct GenerationSettings {
           octaves(5),
           persistence(0.5f),
           lacunarity(2.5f),
-          offset{0.0f, 0.0f}
+          offset{0.0f, 0.0f},
+          noise_type(NoiseType::PERLIN_3D),
+          lattice_hash(LatticeHash::PERMUTATION),
+          warp_strength(0.0f),
+          warp_scale(0.25f),
+          origin{0, 0},
+          spacing(1),
+          height_range(HeightRange::OBSERVED),
+          mesh_error(0.0f)
     {
     }
 
@@ -39,305 +98,2316 @@ struct GenerationSettings {
                octaves == other.octaves &&
                fabs(persistence - other.persistence) < epsilon &&
                fabs(lacunarity - other.lacunarity) < epsilon &&
-               offset == other.offset;
+               offset == other.offset &&
+               noise_type == other.noise_type &&
+               lattice_hash == other.lattice_hash &&
+               fabs(warp_strength - other.warp_strength) < epsilon &&
+               fabs(warp_scale - other.warp_scale) < epsilon &&
+               origin == other.origin &&
+               spacing == other.spacing &&
+               height_range == other.height_range &&
+               mesh_error == other.mesh_error;
+    }
+
+    // Inputs of the cached generation stages, compared exactly. height_scale
+    // isn't an input of any stage, the terrain shader applies it, and
+    // height_range only matters to the vertices.
+    bool same_noise_inputs(const GenerationSettings& other) const {
+        return same_layer_inputs(other) &&
+               octaves == other.octaves &&
+               persistence == other.persistence;
+    }
+
+    // Everything the octave layers depend on, which leaves out the octave
+    // count and the persistence
+    bool same_layer_inputs(const GenerationSettings& other) const {
+        return seed == other.seed &&
+               scale == other.scale &&
+               lacunarity == other.lacunarity &&
+               offset == other.offset &&
+               noise_type == other.noise_type &&
+               lattice_hash == other.lattice_hash &&
+               warp_strength == other.warp_strength &&
+               warp_scale == other.warp_scale &&
+               origin == other.origin &&
+               spacing == other.spacing;
+    }
+
+    bool same_climate_inputs(const GenerationSettings& other) const {
+        return seed == other.seed &&
+               scale == other.scale &&
+               offset == other.offset &&
+               lattice_hash == other.lattice_hash &&
+               origin == other.origin &&
+               spacing == other.spacing;
+    }
+};
+
+// A vertex in 8 bytes. Where it lies across the ground follows from its
+// place in the mesh, so only its height in [0, 1] as a 16 bit fraction, its
+// normal folded onto an octahedron in two 16 bit snorms, and the biome that
+// colours it are kept. Heights and normals are for a height scale of 1; the
+// terrain shader stretches both vertically.
+struct Vertex {
+    std::uint16_t height;
+    std::array<std::int16_t, 2> normal;
+    std::uint8_t material;
+    std::uint8_t padding;
+
+    static Vertex pack(const float height, const glm::vec3& normal, const Biome biome) {
+        return Vertex {
+            static_cast<std::uint16_t>(std::lround(std::clamp(height, 0.0f, 1.0f) * 65535.0f)),
+            pack_normal(normal),
+            static_cast<std::uint8_t>(biome),
+            0
+        };
+    }
+
+    float unpacked_height() const {
+        return height / 65535.0f;
+    }
+
+    // Projects the unit normal onto the octahedron |x| + |y| + |z| = 1 and
+    // keeps its x and z, folding the lower half over the upper one
+    static std::array<std::int16_t, 2> pack_normal(const glm::vec3& normal) {
+        const auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        auto x = normal.x / length;
+        auto z = normal.z / length;
+        if (normal.y < 0.0f) {
+            const auto folded_x = std::copysign(1.0f - std::abs(z), x);
+            z = std::copysign(1.0f - std::abs(x), z);
+            x = folded_x;
+        }
+
+        const auto snorm = [](float value) {
+            return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+        };
+        return { snorm(x), snorm(z) };
+    }
+};
+
+static_assert(sizeof(Vertex) == 8, "Vertices are packed into 8 bytes");
+
+using VertexData = std::vector<Vertex>;
+
+// A sample in 4 bytes for a terrain shader that works out the rest: its
+// height in [0, 1], below the water too, as a 16 bit fraction split into
+// bytes, and its climate in [0, 1], the temperature already cooled by the
+// altitude. Kept as bytes, so it reads the same on any machine as the
+// texels of an RGBA8UI texture.
+struct HeightSample {
+    std::uint8_t height_low;
+    std::uint8_t height_high;
+    std::uint8_t temperature;
+    std::uint8_t moisture;
+
+    static HeightSample pack(const float height, const float temperature, const float moisture) {
+        const auto fraction = static_cast<unsigned int>(std::lround(std::clamp(height, 0.0f, 1.0f) * 65535.0f));
+        const auto byte = [](float value) {
+            return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+        };
+        return HeightSample {
+            static_cast<std::uint8_t>(fraction & 0xFF),
+            static_cast<std::uint8_t>(fraction >> 8),
+            byte(temperature),
+            byte(moisture)
+        };
+    }
+
+    float unpacked_height() const {
+        return (height_low | height_high << 8) / 65535.0f;
+    }
+};
+
+static_assert(sizeof(HeightSample) == 4, "Height samples are packed into 4 bytes");
+
+using SampleData = std::vector<HeightSample>;
+
+// What the renderer is sent for every sample of the terrain
+enum class SampleFormat {
+    // Vertices, shaded and coloured on the CPU
+    VERTICES,
+    // Height samples in a texture, which the terrain shader pulls its
+    // vertices from, working out their normals and colours itself. Only the
+    // noise stages and normalising the heights are left to the CPU.
+    HEIGHT_TEXTURE
+};
+
+// Vertices [first, first + count) of the full resolution mesh
+struct VertexRange {
+    std::size_t first;
+    std::size_t count;
+};
+
+// Vertices of the full resolution mesh yet to be sent somewhere, or all of
+// them
+struct PendingRanges {
+    std::vector<VertexRange> ranges;
+    bool all = false;
+};
+
+// A mesh handed from the generation thread to the renderer, as vertices or
+// samples depending on the terrain's format. Without ranges it is a whole
+// level of detail; with them it only holds those vertices of the full
+// resolution mesh, packed in order. Indices, when there are any,
+// triangulate the full resolution mesh in place of its grid.
+//
+// Vertices are staged for the renderer to copy into the vertex buffer,
+// unless the buffer's region of it is mapped, in which case they are
+// written there directly and nothing is left to copy.
+struct MeshUpdate {
+    VertexData vertices;
+    SampleData samples;
+    std::vector<VertexRange> ranges;
+    Indices indices;
+    glm::ivec2 origin;
+    int spacing;
+    Vertex* region = nullptr;
+    std::size_t vertex_count = 0;
+
+    // Where a whole level of count vertices goes
+    Vertex* write_vertices(const std::size_t count) {
+        vertex_count = count;
+        if (region) {
+            return region;
+        }
+        vertices.resize(count);
+        return vertices.data();
+    }
+
+    // Vertices held, in either format
+    std::size_t size() const {
+        return samples.empty() ? vertex_count : samples.size();
     }
 };
 
+// Where a standalone tile of terrain starts, in samples, and the cells
+// between its samples
+struct TilePlacement {
+    glm::ivec2 origin;
+    int spacing;
+};
+
+// Part of the element buffer that draws a size x size grid of vertices,
+// sampled stride apart
+struct MeshLevel {
+    unsigned int size;
+    unsigned int stride;
+    GridIndices cells;
+};
+
 namespace {
-    struct Vertex {
-        glm::vec3 position;
-        glm::vec3 normal;
-        glm::vec3 color;
+    // Raw fBm heights along with their analytic slopes along the map's x and
+    // y axes, and the range the heights get normalised from
+    struct HeightMap {
+        MapGrid heights;
+        MapGrid slope_x;
+        MapGrid slope_y;
+        float min_height;
+        float max_height;
+    };
+
+    // Sea level climate in [0, 1]; the temperature isn't clamped yet as the
+    // altitude still gets taken off it
+    struct ClimateMap {
+        MapGrid temperature;
+        MapGrid moisture;
+    };
+
+    // Domain warp displacement at one point of the coarse warp lattice, with
+    // its partial derivatives, all in noise sample space
+    struct WarpSample {
+        float x;
+        float y;
+        float x_dx;
+        float x_dy;
+        float y_dx;
+        float y_dy;
+    };
+
+    // Part of the warp lattice, whose points lie every warp_step samples
+    // from the world origin
+    struct WarpField {
+        std::vector<WarpSample> samples;
+        int first_x;
+        int first_y;
+        unsigned int width;
+    };
+
+    // Rows and columns of a map, counted at the map's stride
+    struct SampleRegion {
+        unsigned int first_row;
+        unsigned int end_row;
+        unsigned int first_column;
+        unsigned int end_column;
+    };
+
+    WarpSample interpolate(const WarpSample& a, const WarpSample& b, float t) {
+        return WarpSample {
+            a.x + t * (b.x - a.x),
+            a.y + t * (b.y - a.y),
+            a.x_dx + t * (b.x_dx - a.x_dx),
+            a.x_dy + t * (b.x_dy - a.x_dy),
+            a.y_dx + t * (b.y_dx - a.y_dx),
+            a.y_dy + t * (b.y_dy - a.y_dy)
+        };
+    }
+
+    // Lets a running generation notice that a newer request has replaced
+    // it. A default token never cancels.
+    struct CancelToken {
+        const std::atomic<std::uint64_t>* latest_request = nullptr;
+        std::uint64_t request = 0;
+
+        bool cancelled() const {
+            return latest_request && latest_request->load(std::memory_order_relaxed) != request;
+        }
     };
 
-    using VertexData = std::vector<Vertex>;
-    using TerrainData = std::tuple<VertexData, Indices, unsigned int>;
+    // Stage results kept between generations, so a settings change only
+    // re-runs the stages whose inputs it touches. Each map remembers the
+    // settings it was built from and the finest stride it is complete at, or
+    // 0 when nothing in it is valid. The vertices are rebuilt every time,
+    // they are cheap next to either noise stage. With layers set, a request
+    // that keeps the layers' inputs, such as a persistence change, sums the
+    // height map from cached octaves of noise. Any other change runs the
+    // fused kernel, which is quicker from cold. The buffers only
+    // live for one stage come out of scratch, and everything else is sized
+    // once and overwritten, so generating again doesn't allocate.
+    //
+    // The last full resolution mesh is kept too, as vertices or samples
+    // depending on the format, so panning can update just the vertices that
+    // change.
+    struct GenerationCache {
+        HeightMap height_map;
+        WarpField warp_field;
+        GenerationSettings noise_settings;
+        unsigned int noise_stride;
+        OctaveLayerCache* layers;
+        bool layered;
+        ScratchArena* scratch;
+
+        // level_strides of the grid
+        std::vector<unsigned int> strides;
+
+        ClimateMap climate_map;
+        GenerationSettings climate_settings;
+        unsigned int climate_stride;
+
+        SampleFormat format;
+        VertexData mesh;
+        SampleData samples;
+        bool mesh_complete;
+        HeightRange mesh_range;
+    };
+
+    using TerrainData = std::tuple<Indices, std::vector<MeshLevel>>;
 }
 
 class TerrainSquares : public Drawable<TerrainSquares> {
 public:
     explicit TerrainSquares(
         VertexArrayObject&& t_vao, 
-        VertexBufferObject&& t_vbo, 
+        StreamingBuffer&& t_vertex_stream,
         VertexBufferObject&& t_ebo,
-        unsigned int t_draw_count,
-        Indices&& t_indices,
-        unsigned int t_grid_size
+        TextureObject&& t_sample_texture,
+        TextureObject&& t_biome_texture,
+        std::vector<MeshLevel>&& t_levels,
+        unsigned int t_grid_size,
+        SampleFormat t_sample_format
     ) : Drawable(std::move(t_vao)), 
-        vbo(std::move(t_vbo)), 
+        vertex_stream(std::move(t_vertex_stream)),
         ebo(std::move(t_ebo)),
-        draw_count(t_draw_count),
-        indices(std::move(t_indices)),
-        grid_size(t_grid_size)
+        sample_texture(std::move(t_sample_texture)),
+        biome_texture(std::move(t_biome_texture)),
+        sample_format(t_sample_format),
+        texture_size(0),
+        draw_count(0),
+        first_index(0),
+        drawn_size(0),
+        drawn_stride(1),
+        levels(std::move(t_levels)),
+        grid_size(t_grid_size),
+        index_type(GridIndices::index_type(std::size_t(grid_size) * grid_size, levels.back().cells.primitive())),
+        adaptive_first(levels.back().cells.first_index() + levels.back().cells.count()),
+        adaptive_count(0),
+        mailbox(0),
+        front(2),
+        busy_regions(0),
+        front_origin(0, 0),
+        front_spacing(1),
+        ring_drawn(false),
+        latest_request(0),
+        has_request(false),
+        stopping(false),
+        layer_cache(default_layer_cache_budget),
+        rtin(std::max(t_grid_size, 2u))
     {
+        // Each buffer's vertices go into its own region, written straight
+        // through the mapping where the stream is persistent
+        if (sample_format == SampleFormat::VERTICES && vertex_stream.persistent()) {
+            const auto region_bytes = sizeof(Vertex) * grid_size * grid_size;
+            for (unsigned int i = 0; i < buffers.size(); i++) {
+                buffers[i].region = static_cast<Vertex*>(vertex_stream.map(i, 0, region_bytes, false));
+            }
+        }
+
+        generation_thread = std::thread([this] { generation_loop(); });
     }
 
-    static std::shared_ptr<TerrainSquares> create_impl(const unsigned int grid_size) {
+    ~TerrainSquares() {
+        {
+            std::lock_guard<std::mutex> lock(request_mutex);
+            stopping = true;
+            latest_request++;
+        }
+        wake_generation();
+        generation_thread.join();
+    }
+
+    static std::shared_ptr<TerrainSquares> create_impl(
+        const unsigned int grid_size,
+        const IndexOptions index_options = GridIndices::default_options,
+        const SampleFormat sample_format = SampleFormat::VERTICES)
+    {
+        // A region of full resolution vertices per mailbox buffer. Height
+        // textures leave the vertex array without attributes, the shader
+        // finds its vertices from their index alone.
+        const auto region_bytes = sample_format == SampleFormat::VERTICES ? sizeof(Vertex) * grid_size * grid_size : 0;
         auto terrain_vao = VertexArrayObject();
-        auto terrain_vbo = VertexBufferObject(VertexBufferType::ARRAY);
+        auto vertex_stream = StreamingBuffer(VertexBufferType::ARRAY, region_bytes, stream_regions, StreamingBuffer::preferred_mode());
         auto terrain_ebo = VertexBufferObject(VertexBufferType::ELEMENT);
+        auto sample_texture = TextureObject(TextureType::TEXTURE_2D);
+        auto biome_texture = TextureObject(TextureType::TEXTURE_3D);
 
-        auto [terrain_attributes, indices, draw_count] = generate_terrain(grid_size);
+        auto [indices, levels] = generate_terrain(grid_size, index_options);
         terrain_vao.bind();
 
-        terrain_vbo.bind();
-        terrain_vbo.send_data(terrain_attributes, VertexDrawType::DYNAMIC);
-
-        terrain_vbo.enable_attribute_pointer(0, 3, VertexDataType::FLOAT, 9, 0);
-        terrain_vbo.enable_attribute_pointer(1, 3, VertexDataType::FLOAT, 9, 3);
-        terrain_vbo.enable_attribute_pointer(2, 3, VertexDataType::FLOAT, 9, 6);
+        vertex_stream.vbo.bind();
+        if (sample_format == SampleFormat::VERTICES) {
+            enable_vertex_attributes(vertex_stream.vbo, 0, 1);
+        } else {
+            const auto table = Biomes::lookup_table(biome_cells);
+            biome_texture.bind(biome_unit);
+            biome_texture.send_data(TexelFormat::R8UI, biome_cells, biome_cells, biome_cells, table.data());
+        }
 
+        std::vector<std::uint16_t> narrowed;
+        const auto index_type = GridIndices::index_type(std::size_t(grid_size) * grid_size, index_options.primitive);
         terrain_ebo.bind();
-        terrain_ebo.send_data(indices, VertexDrawType::STATIC);
+        terrain_ebo.send_indices(indices, index_type, VertexDrawType::STATIC, narrowed);
 
-        terrain_vbo.unbind();
+        vertex_stream.vbo.unbind();
         terrain_vao.unbind();
 
-        return std::make_shared<TerrainSquares>(
+        auto terrain = std::make_shared<TerrainSquares>(
             std::move(terrain_vao), 
-            std::move(terrain_vbo), 
+            std::move(vertex_stream),
             std::move(terrain_ebo),
-            draw_count, 
-            std::move(indices),
-            grid_size
+            std::move(sample_texture),
+            std::move(biome_texture),
+            std::move(levels),
+            grid_size,
+            sample_format
         );
+
+        // The terrain itself is generated in the background, so the first
+        // frames come up straight away and are filled in by the previews
+        GenerationSettings settings;
+        terrain->update(settings);
+
+        return terrain;
     }
 
+    // Queues a regeneration on the background thread and returns straight
+    // away. A generation that is still running for older settings gets
+    // cancelled; each level of detail is swapped in by the first draw after
+    // it finishes.
     void update_impl(GenerationSettings& settings) {
-        auto updated_terrain = generate_terrain_data(grid_size, settings);
-        vao.bind();
-        vbo.bind();
-        vbo.update_data(updated_terrain);
-        vbo.unbind();        
-        vao.unbind();
+        {
+            std::lock_guard<std::mutex> lock(request_mutex);
+
+            // Nothing to generate for settings that only the shader reads
+            const auto requested = latest_request.load() > 0;
+            if (requested &&
+                requested_settings.same_noise_inputs(settings) &&
+                requested_settings.same_climate_inputs(settings) &&
+                requested_settings.height_range == settings.height_range &&
+                requested_settings.mesh_error == settings.mesh_error)
+            {
+                requested_settings = settings;
+                return;
+            }
+
+            requested_settings = settings;
+            has_request = true;
+            latest_request++;
+        }
+        wake_generation();
     }
 
+    // Draws the mesh taken in by the last prepare_draw
     DrawType draw_impl() {
         vao.bind();
+        if (ring_drawn && adaptive_count > 0) {
+            return DrawType(DrawElements {
+                VertexPrimitive::TRIANGLES,
+                adaptive_count,
+                index_type,
+                adaptive_first
+            });
+        }
+
+        if (ring_drawn) {
+            return DrawType(MultiDrawElements {
+                levels.back().cells.primitive(),
+                ring_counts,
+                index_type,
+                ring_offsets
+            });
+        }
+
         auto draw_type = DrawElements {
-            VertexPrimitive::TRIANGLES,
+            levels.back().cells.primitive(),
             draw_count,
-            VertexDataType::UNSIGNED_INT,
-            indices
+            index_type,
+            first_index
         };
 
         return DrawType(draw_type);
     }
 
+    // Memory the octave layer cache may use, 0 to turn it off. Takes effect
+    // from the next generation.
+    void set_layer_cache_budget(std::size_t bytes) {
+        layer_cache.set_budget(bytes);
+    }
+
+    OctaveLayerStats layer_cache_stats() const {
+        return layer_cache.stats();
+    }
+
+    // Points attributes first to first + 2 at the height, normal and
+    // material of the bound buffer's vertices, which come in records of
+    // vertex_stride vertices with these offset vertices into each
+    static void enable_vertex_attributes(VertexBufferObject& vbo, unsigned int first, unsigned int vertex_stride, unsigned int offset = 0) {
+        const auto shorts = vertex_stride * sizeof(Vertex) / 2;
+        vbo.enable_attribute_pointer(first, 1, VertexDataType::UNSIGNED_SHORT, shorts, offset * 4, AttributeMode::NORMALIZED);
+        vbo.enable_attribute_pointer(first + 1, 2, VertexDataType::SHORT, shorts, offset * 4 + 1, AttributeMode::NORMALIZED);
+        vbo.enable_attribute_pointer(first + 2, 1, VertexDataType::UNSIGNED_BYTE, shorts * 2, offset * 8 + 6, AttributeMode::INTEGER);
+    }
+
+    // Takes in any finished mesh and tells a shader of Shaders::Terrain, or
+    // of Shaders::TerrainPulled for a height texture, where its vertices
+    // lie, which follows from their index: row by row from the origin in
+    // the previews, and scrolled around the ring by the origin at full
+    // resolution. Meshes finished later wait for the next call, so the draws
+    // until then match the shader.
+    void prepare_draw(const Shader& shader) {
+        upload_finished_terrain();
+
+        if (sample_format == SampleFormat::HEIGHT_TEXTURE) {
+            sample_texture.bind(sample_unit);
+            biome_texture.bind(biome_unit);
+            shader.set_int("samples", static_cast<int>(sample_unit));
+            shader.set_int("biomes", static_cast<int>(biome_unit));
+            shader.set_float("water_level", water_level);
+        }
+
+        const auto ring_offset = ring_drawn
+            ? glm::ivec2(wrap(front_origin.y, grid_size), wrap(front_origin.x, grid_size))
+            : glm::ivec2(0, 0);
+        shader.set_int("mesh_size", static_cast<int>(drawn_size));
+        shader.set_ivec2("ring_offset", ring_offset);
+        shader.set_vec2("mesh_corner", glm::vec2(front_origin.y, front_origin.x) * static_cast<float>(front_spacing));
+        shader.set_float("mesh_spacing", static_cast<float>(drawn_stride * front_spacing));
+    }
+
+    // Origin of the mesh currently drawn. Vertices lie at their world
+    // sample positions, so translating by minus this keeps the window
+    // centred while panning.
+    glm::ivec2 drawn_origin() const {
+        return front_origin;
+    }
+
+    static constexpr std::size_t default_layer_cache_budget = 64 << 20;
+
+    // Heights at or below this are drawn as flat water
+    static constexpr float water_level = 0.35f;
+
+    // Triangles the last draw was made of
+    std::size_t triangle_count() const {
+        if (ring_drawn && adaptive_count > 0) {
+            return adaptive_count / 3;
+        }
+        // The ring leaves out one row and one column of its cells
+        return drawn_size > 1 ? std::size_t(drawn_size - 1) * (drawn_size - 1) * 2 : 0;
+    }
+
+    // Growth of the generation scratch; steady state generations leave the
+    // allocation count alone
+    ScratchStats scratch_stats() const {
+        return scratch_arena.stats();
+    }
+
 private:
-    static TerrainData generate_terrain(const unsigned int grid_size) {
+    // Streamed chunks run through the same generation stages
+    friend class TerrainChunks;
+
+    // The benchmark times the stages one by one
+    friend class TerrainBenchmark;
+
+    // One region of the vertex stream per mailbox buffer
+    static constexpr unsigned int stream_regions = 3;
+
+    // The element buffer holds one grid per level of detail, so previews are
+    // drawn straight from their own smaller meshes
+    static TerrainData generate_terrain(const unsigned int grid_size, const IndexOptions index_options) {
         Indices indices;
-        indices.reserve(grid_size * grid_size * 2);
-
-        auto index = 0;
-        for(auto x = 0; x < grid_size; x++) {
-            for(auto z = 0; z < grid_size; z++) {
-                // Calculate indices
-                if(x < grid_size - 1 && z < grid_size - 1) {
-                    indices.push_back(index);
-                    indices.push_back(index + grid_size + 1);
-                    indices.push_back(index + grid_size);
-
-                    indices.push_back(index + grid_size + 1);
-                    indices.push_back(index);
-                    indices.push_back(index + 1);
+        std::vector<MeshLevel> levels;
+
+        for (auto stride : level_strides(grid_size)) {
+            const auto size = (grid_size - 1) / stride + 1;
+
+            // The full resolution mesh is a ring that panning scrolls
+            // through, so its cells wrap around both edges and the one
+            // row and column of cells across the window's seam are
+            // skipped when drawing
+            if (stride == 1 && size > 1) {
+                const auto cells = GridIndices(size, size, index_options, indices.size());
+                cells.append(indices, [size](unsigned int x, unsigned int z) {
+                    return x % size * size + z % size;
+                });
+                levels.push_back(MeshLevel { size, stride, cells });
+                continue;
+            }
+
+            const auto cells = GridIndices(size - 1, size - 1, index_options, indices.size());
+            cells.append(indices, [size](unsigned int x, unsigned int z) {
+                return x * size + z;
+            });
+            levels.push_back(MeshLevel { size, stride, cells });
+        }
+
+        // Room for an adaptive triangulation of the full resolution mesh,
+        // which never has more triangles than its grid
+        indices.resize(indices.size() + std::size_t(grid_size) * grid_size * 6);
+
+        return std::tuple(std::move(indices), std::move(levels));
+    }
+
+    // Generates standalone tiles of cells x cells samples, one per
+    // placement, across all cores with one cache each. A tile's maps reach
+    // one sample past its (cells + 1)^2 vertices, so the vertices along its
+    // far edges take their colour from their own cells like every other
+    // vertex. With the analytic height range, tiles that share an edge
+    // agree exactly on its vertices, and tiles of different spacings on the
+    // heights and normals of the samples they share. Tiles are laid out row
+    // by row; complete[i] is left 0 when the token got cancelled before
+    // tile i was done.
+    static void generate_tiles(
+        std::vector<GenerationCache>& caches,
+        const unsigned int cells,
+        const GenerationSettings& settings,
+        const std::vector<TilePlacement>& placements,
+        const CancelToken& cancel,
+        std::vector<VertexData>& tiles,
+        std::vector<char>& complete)
+    {
+        const auto grid_size = cells + 2;
+        const auto size = cells + 1;
+
+        TaskScheduler::instance().parallel_for(placements.size(), [&](std::size_t i) {
+            auto& cache = caches[i];
+            auto tile_settings = settings;
+            tile_settings.origin = placements[i].origin;
+            tile_settings.spacing = placements[i].spacing;
+
+            complete[i] = false;
+            update_cache(cache, grid_size, tile_settings, 1, cancel);
+            cache.mesh.resize(std::size_t(grid_size) * grid_size);
+            if (cancel.cancelled() ||
+                !generate_vertices(cache, grid_size, 1, tile_settings, whole_map(grid_size), cancel, cache.mesh.data())) {
+                return;
+            }
+
+            // Vertex x runs along the map's rows and z along its columns,
+            // and the full resolution mesh is wrapped like the maps
+            const auto row_origin = wrap(tile_settings.origin.y, grid_size);
+            const auto column_origin = wrap(tile_settings.origin.x, grid_size);
+            auto& tile = tiles[i];
+            tile.resize(size * size);
+            for (unsigned int x = 0; x < size; x++) {
+                const auto ring_row = (x + row_origin) % grid_size * grid_size;
+                for (unsigned int z = 0; z < size; z++) {
+                    tile[x * size + z] = cache.mesh[ring_row + (z + column_origin) % grid_size];
                 }
-                index++;
+            }
+            complete[i] = true;
+        });
+    }
+
+    static constexpr unsigned int coarsest_stride = 8;
+
+    // Strides of the levels generated for a grid, coarsest first. Previews
+    // sample every 8th, 4th and 2nd point before the full resolution pass;
+    // ones with less than a single cell are left out.
+    static std::vector<unsigned int> level_strides(const unsigned int grid_size) {
+        std::vector<unsigned int> strides;
+        for (auto stride = coarsest_stride; stride > 1; stride /= 2) {
+            if (grid_size > stride) {
+                strides.push_back(stride);
             }
         }
+        strides.push_back(1);
 
-        GenerationSettings settings;
+        return strides;
+    }
+
+    // Generates the terrain coarse to fine. Every level is written in the
+    // cache's format into the buffer acquire(cancel) returns, after which
+    // publish(stride) hands it over. Previews go straight into the buffer;
+    // the full resolution mesh goes into the cache first, where panning
+    // keeps it up to date, and is copied over. Stages only evaluate what the
+    // cache is missing, which for a fresh map is the points the level before
+    // skipped. Stops once the token gets cancelled or acquire returns null.
+    template <typename A, typename P>
+    static void generate_terrain_levels(
+        GenerationCache& cache,
+        const unsigned int grid_size,
+        const GenerationSettings& settings,
+        const CancelToken& cancel,
+        A&& acquire,
+        P&& publish)
+    {
+        cache.mesh_complete = false;
+        const auto vertices = cache.format == SampleFormat::VERTICES;
+
+        for (auto stride : cache.strides) {
+            update_cache(cache, grid_size, settings, stride, cancel);
+            if (cancel.cancelled()) {
+                return;
+            }
+
+            const auto size = (grid_size - 1) / stride + 1;
+            const auto count = std::size_t(size) * size;
+            MeshUpdate* target = nullptr;
+            if (stride == 1) {
+                cache.mesh.resize(vertices ? count : 0);
+                generate_mesh(cache, grid_size, stride, settings, whole_map(size), cancel, cache.mesh.data(), cache.samples);
+                if (cancel.cancelled()) {
+                    return;
+                }
+                cache.mesh_complete = true;
+                cache.mesh_range = settings.height_range;
 
-        auto terrain_attributes = generate_terrain_data(grid_size, settings);
+                target = acquire(cancel);
+                if (!target) {
+                    return;
+                }
+                if (vertices) {
+                    std::copy(cache.mesh.begin(), cache.mesh.end(), target->write_vertices(count));
+                } else {
+                    target->samples = cache.samples;
+                }
+            } else {
+                target = acquire(cancel);
+                if (!target) {
+                    return;
+                }
+                generate_mesh(cache, grid_size, stride, settings, whole_map(size), cancel, vertices ? target->write_vertices(count) : nullptr, target->samples);
+                if (cancel.cancelled()) {
+                    return;
+                }
+            }
 
-        return std::tuple(terrain_attributes, indices, indices.size());
+            publish(stride);
+        }
     }
 
-    static std::vector<Vertex> generate_terrain_data(unsigned int grid_size, const GenerationSettings& settings) {
-        auto height_map = generate_height_map(grid_size, settings);
+    // Moves a finished terrain to settings that differ only in their origin
+    // by evaluating just the rows and columns scrolled into the window, so a
+    // step costs O(grid_size) rather than O(grid_size^2). The vertices that
+    // changed are added to changed; when the step widens the height range,
+    // every vertex is rebuilt and changed covers the whole mesh.
+    //
+    // Returns false, leaving the cache alone, when the cache doesn't hold
+    // the finished terrain for the rest of the settings or the step is a
+    // whole window or more.
+    //
+    // Steps are short and always run to the end, as a half written ring
+    // would be neither window.
+    static bool pan_terrain(
+        GenerationCache& cache,
+        const unsigned int grid_size,
+        const GenerationSettings& settings,
+        std::vector<VertexRange>& changed)
+    {
+        if (!cache.mesh_complete || cache.noise_stride != 1 || cache.climate_stride != 1 || cache.mesh_range != settings.height_range) {
+            return false;
+        }
+
+        auto moved_noise = cache.noise_settings;
+        auto moved_climate = cache.climate_settings;
+        moved_noise.origin = settings.origin;
+        moved_climate.origin = settings.origin;
+        if (!moved_noise.same_noise_inputs(settings) ||
+            !moved_climate.same_climate_inputs(settings) ||
+            cache.noise_settings.origin != cache.climate_settings.origin)
+        {
+            return false;
+        }
 
-        VertexData terrain_attributes(grid_size * grid_size, Vertex {
-            glm::vec3(0.0f, 0.0f, 0.0f),
-            glm::vec3(0.0f, 1.0f, 0.0f),
-            glm::vec3(1.0f, 1.0f, 1.0f)
-        });
+        const auto step = settings.origin - cache.noise_settings.origin;
+        const auto size = static_cast<int>(grid_size);
+        if (step == glm::ivec2(0, 0) || std::abs(step.x) >= size || std::abs(step.y) >= size) {
+            return false;
+        }
 
-        auto va_index = 0;
-        for(auto x = 0; x < grid_size; x++) {
-            for(auto z = 0; z < grid_size; z++) {
-                // TODO: Make the water height more realistic
-                auto height = (height_map[va_index] > 0.35 ? height_map[va_index] : 0.35f);
-                terrain_attributes[va_index].position = glm::vec3(x, height * settings.height_scale, z);
-                va_index++;
-            }
-        }
-        
-        // TODO: Put this somewhere
-        static auto heights = std::vector{0.3, 0.4, 0.45, 0.55, 0.6, 0.7, 0.9, 1.0};
-        static auto colors  = std::vector {
-            glm::vec3(0.12f, 0.29f, 0.72f),
-            glm::vec3(0.13f, 0.30f, 0.76f),
-            glm::vec3(0.77f, 0.80f, 0.28f),
-            glm::vec3(0.20f, 0.55f, 0.0f),
-            glm::vec3(0.14f, 0.36f, 0.0f),
-            glm::vec3(0.30f, 0.20f, 0.17f),
-            glm::vec3(0.23f, 0.18f, 0.16f),
-            glm::vec3(1.0f, 1.0f, 1.0f),
-        };
+        // Rows and columns of the new window that weren't in the old one
+        const auto new_rows = step.y > 0 ? SampleRegion { grid_size - step.y, grid_size, 0, grid_size } : SampleRegion { 0, static_cast<unsigned int>(-step.y), 0, grid_size };
+        const auto new_columns = step.x > 0 ? SampleRegion { 0, grid_size, grid_size - step.x, grid_size } : SampleRegion { 0, grid_size, 0, static_cast<unsigned int>(-step.x) };
 
-        auto height_centroid = [](float height1, float height2, float height3) {
-            return (height1 + height2 + height3) / 3.0f;
-        };
+        // The columns skip the new rows, which cover them already
+        std::array<SampleRegion, 2> exposed;
+        std::size_t exposed_count = 0;
+        if (step.y != 0) {
+            exposed[exposed_count++] = new_rows;
+        }
+        if (step.x != 0) {
+            auto rows_left = new_columns;
+            rows_left.first_row = step.y > 0 ? 0 : new_rows.end_row;
+            rows_left.end_row = step.y > 0 ? new_rows.first_row : grid_size;
+            if (rows_left.first_row < rows_left.end_row) {
+                exposed[exposed_count++] = rows_left;
+            }
+        }
 
-        va_index = 0;
-        for(auto x = 0; x < grid_size; x++) {
-            for(auto z = 0; z < grid_size; z++) {
-                if(x < grid_size - 1 && z < grid_size - 1) {
-                    // Extract first triangle using same method to calculate indices
-                    auto& triangle1_va = terrain_attributes.at(va_index);
-                    auto& triangle1_vb = terrain_attributes.at(va_index + grid_size + 1);
-                    auto& triangle1_vc = terrain_attributes.at(va_index + grid_size);
-
-                    // Same with second triangle
-                    auto& triangle2_va = terrain_attributes.at(va_index + grid_size + 1);
-                    auto& triangle2_vb = terrain_attributes.at(va_index);
-                    auto& triangle2_vc = terrain_attributes.at(va_index + 1);
-
-                    // Recalculate surface normals
-                    auto triangle1_normal = glm::normalize(glm::cross(triangle1_vb.position - triangle1_va.position, triangle1_vc.position - triangle1_va.position));
-                    triangle1_va.normal = triangle1_normal;
-                    triangle1_vb.normal = triangle1_normal;
-                    triangle1_vc.normal = triangle1_normal;
-
-                    auto triangle2_normal = glm::normalize(glm::cross(triangle2_vb.position - triangle2_va.position, triangle2_vc.position - triangle2_va.position));
-                    triangle2_va.normal = triangle2_normal;
-                    triangle2_vb.normal = triangle2_normal;
-                    triangle2_vc.normal = triangle2_normal;
-
-                    // Recalculate colors
-                    //   Find triangle1 color
-                    // Extract first triangle using same method to calculate indices
-                    auto& triangle1_va_height = height_map[va_index];
-                    auto& triangle1_vb_height = height_map[va_index + grid_size + 1];
-                    auto& triangle1_vc_height = height_map[va_index + grid_size];
-
-                    // Same with second triangle
-                    auto& triangle2_va_height = height_map[va_index + grid_size + 1];
-                    auto& triangle2_vb_height = height_map[va_index];
-                    auto& triangle2_vc_height = height_map[va_index + 1];
-
-                    auto triangle1_centroid_height = height_centroid(triangle1_va_height, triangle1_vb_height, triangle1_vc_height);
-
-                    auto color = glm::vec3(1.0f, 1.0f, 1.0f);
-
-                    auto color_index = 0;
-                    auto height = triangle1_centroid_height;
-                    for(auto &segment_color : colors) {
-                        if(height <= heights[color_index]) {
-                            color = segment_color;
-                            break;
-                        }
-                        color_index++;
-                    }
+        // The octave layers are keyed by the window's origin, so none of
+        // them would be hit again; they are dropped rather than left holding
+        // the budget
+        if (cache.layers) {
+            cache.layers->clear();
+        }
 
-                    triangle1_va.color = color;
-                    triangle1_vb.color = color;
-                    triangle1_vc.color = color;
+        const auto [min_height, max_height] = height_bounds(cache.height_map, settings);
 
-                    //   Find triangle2 color
-                    auto triangle2_centroid_height = height_centroid(triangle2_va_height, triangle2_vb_height, triangle2_vc_height);
+        // The whole window warp field is only used to fill in the map, which
+        // is complete, so its memory holds each region's field instead
+        for (std::size_t i = 0; i < exposed_count; i++) {
+            const auto& region = exposed[i];
+            if (settings.warp_strength != 0.0f) {
+                generate_warp_field(grid_size, settings, region, *cache.scratch, cache.warp_field);
+            }
+            refine_height_map(cache.height_map, grid_size, settings, cache.warp_field, nullptr, *cache.scratch, 1, false, region, CancelToken());
+            refine_climate_map(cache.climate_map, grid_size, settings, *cache.scratch, 1, false, region, CancelToken());
+        }
 
-                    color_index = 0;
-                    height = triangle2_centroid_height;
-                    for(auto &segment_color : colors) {
-                        if(height <= heights[color_index]) {
-                            color = segment_color;
-                            break;
-                        }
-                        color_index++;
-                    }
+        cache.noise_settings = settings;
+        cache.climate_settings = settings;
+
+        // Observed heights are normalised over the range seen so far, so as
+        // long as the new samples fall inside it the vertices that stayed in
+        // the window don't move. The analytic range never changes.
+        const auto [new_min_height, new_max_height] = height_bounds(cache.height_map, settings);
+        if (new_min_height != min_height || new_max_height != max_height) {
+            generate_mesh(cache, grid_size, 1, settings, whole_map(grid_size), CancelToken(), cache.mesh.data(), cache.samples);
+            changed.push_back(VertexRange { 0, std::size_t(grid_size) * grid_size });
+            return true;
+        }
+
+        // Vertices take their colour from the next row and column, or the
+        // previous ones along the window's far edges, so the row and column
+        // next to the new samples and the new far edges change as well.
+        // Samples only depend on their own position.
+        std::array<SampleRegion, 4> dirty;
+        std::size_t dirty_count = 0;
+        if (cache.format == SampleFormat::HEIGHT_TEXTURE) {
+            std::copy(exposed.begin(), exposed.begin() + exposed_count, dirty.begin());
+            dirty_count = exposed_count;
+        } else {
+            if (step.y > 0) {
+                dirty[dirty_count++] = SampleRegion { new_rows.first_row - 1, grid_size, 0, grid_size };
+            } else if (step.y < 0) {
+                dirty[dirty_count++] = new_rows;
+                dirty[dirty_count++] = SampleRegion { grid_size - 1, grid_size, 0, grid_size };
+            }
+            if (step.x > 0) {
+                dirty[dirty_count++] = SampleRegion { 0, grid_size, new_columns.first_column - 1, grid_size };
+            } else if (step.x < 0) {
+                dirty[dirty_count++] = new_columns;
+                dirty[dirty_count++] = SampleRegion { 0, grid_size, grid_size - 1, grid_size };
+            }
+        }
+
+        const auto row_origin = wrap(settings.origin.y, grid_size);
+        const auto column_origin = wrap(settings.origin.x, grid_size);
+        for (std::size_t i = 0; i < dirty_count; i++) {
+            const auto& region = dirty[i];
+            generate_mesh(cache, grid_size, 1, settings, region, CancelToken(), cache.mesh.data(), cache.samples);
 
-                    triangle2_va.color = color;
-                    triangle2_vb.color = color;
-                    triangle2_vc.color = color;
+            // Wrapped rows are contiguous in the ring, columns split in two
+            // where they cross its edge
+            const auto first_column = (region.first_column + column_origin) % grid_size;
+            const auto columns = region.end_column - region.first_column;
+            for (auto row = region.first_row; row < region.end_row; row++) {
+                const auto ring_row = (row + row_origin) % grid_size * grid_size;
+                const auto first_run = std::min(columns, grid_size - first_column);
+                changed.push_back(VertexRange { ring_row + first_column, first_run });
+                if (first_run < columns) {
+                    changed.push_back(VertexRange { ring_row, columns - first_run });
                 }
-                va_index++;
             }
         }
 
-        return terrain_attributes;
+        return true;
     }
 
-    static std::vector<float> generate_height_map(
+    // Cache with room for a grid_size map and nothing valid in it
+    static GenerationCache empty_cache(const unsigned int grid_size, ScratchArena& scratch, const SampleFormat format = SampleFormat::VERTICES) {
+        return GenerationCache {
+            HeightMap {
+                MapGrid(grid_size),
+                MapGrid(grid_size),
+                MapGrid(grid_size),
+                std::numeric_limits<float>::max(),
+                std::numeric_limits<float>::lowest()
+            },
+            WarpField {},
+            GenerationSettings(),
+            0,
+            nullptr,
+            false,
+            &scratch,
+            level_strides(grid_size),
+            ClimateMap {
+                MapGrid(grid_size),
+                MapGrid(grid_size)
+            },
+            GenerationSettings(),
+            0,
+            format,
+            VertexData(),
+            SampleData(),
+            false,
+            HeightRange::OBSERVED
+        };
+    }
+
+    // Runs the noise and climate stages that are stale for these settings or
+    // not yet complete at this stride
+    static void update_cache(
+        GenerationCache& cache,
         const unsigned int grid_size,
-        const GenerationSettings& settings)
+        const GenerationSettings& settings,
+        const unsigned int stride,
+        const CancelToken& cancel)
     {
-		std::vector<float> noise_map(grid_size * grid_size);
+        if (cache.noise_stride == 0 || !cache.noise_settings.same_noise_inputs(settings)) {
+            // A map cancelled before its first level keeps the choice made
+            // for it
+            const auto same_layers = cache.noise_settings.same_layer_inputs(settings);
+            cache.layered = same_layers && (cache.noise_stride != 0 || cache.layered);
+            cache.noise_settings = settings;
+            cache.noise_stride = 0;
+            cache.height_map.min_height = std::numeric_limits<float>::max();
+            cache.height_map.max_height = std::numeric_limits<float>::lowest();
+            cache.warp_field.samples.clear();
+            if (settings.warp_strength != 0.0f) {
+                generate_warp_field(grid_size, settings, whole_map(grid_size), *cache.scratch, cache.warp_field);
+            }
+        }
 
-        // Generate octave noise
-        std::mt19937 gen(settings.seed);
-        std::uniform_int_distribution<> dis(-100000, 100000);
-		std::vector<glm::vec2> octave_offsets(settings.octaves);
-		for (int octave = 0; octave < settings.octaves; octave++) {
-			float offset_x = dis(gen) + settings.offset.x;
-			float offset_y = dis(gen) + settings.offset.y;
-			octave_offsets[octave] = glm::vec2(offset_x, offset_y);
-		}
+        if (cache.noise_stride == 0 || cache.noise_stride > stride) {
+            const auto size = (grid_size - 1) / stride + 1;
+            refine_height_map(cache.height_map, grid_size, settings, cache.warp_field, cache.layered ? cache.layers : nullptr, *cache.scratch, stride, cache.noise_stride == stride * 2, whole_map(size), cancel);
+            if (!cancel.cancelled()) {
+                cache.noise_stride = stride;
+            }
+        }
 
-		float max_noise_height = std::numeric_limits<float>::min();
-		float min_noise_height = std::numeric_limits<float>::max();
+        if (cache.climate_stride == 0 || !cache.climate_settings.same_climate_inputs(settings)) {
+            cache.climate_settings = settings;
+            cache.climate_stride = 0;
+        }
 
-		float half_width = grid_size / 2.0f;
-		float half_height = grid_size / 2.0f;
+        if (cache.climate_stride == 0 || cache.climate_stride > stride) {
+            const auto size = (grid_size - 1) / stride + 1;
+            refine_climate_map(cache.climate_map, grid_size, settings, *cache.scratch, stride, cache.climate_stride == stride * 2, whole_map(size), cancel);
+            if (!cancel.cancelled()) {
+                cache.climate_stride = stride;
+            }
+        }
+    }
 
-        auto index = 0;
-		for (int y = 0; y < grid_size; y++) {
-			for (int x = 0; x < grid_size; x++) {
-		
-				float amplitude = 1.0f;
-				float frequency = 1.0f;
-				float noise_height = 0.0f;
-
-				for (int i = 0; i < settings.octaves; i++) {
-					float sample_x = (x - half_width) / settings.scale * frequency + octave_offsets[i].x;
-					float sample_y = (y - half_height) / settings.scale * frequency + octave_offsets[i].y;
-
-					float perlin_value = Perlin::noise (sample_x, sample_y, sample_x + sample_y) * 2 - 1;
-					noise_height += perlin_value * amplitude;
-
-					amplitude *= settings.persistence;
-					frequency *= settings.lacunarity;
-				}
-
-				if (noise_height > max_noise_height) {
-					max_noise_height = noise_height;
-				} else if (noise_height < min_noise_height) {
-					min_noise_height = noise_height;
-				}
-
-				noise_map[index] = noise_height;
-                index++;
-			}
-		}
+    // Normalises, displaces, shades and colours every stride-th sample of the
+    // cached maps into a mesh of ((grid_size - 1) / stride + 1)^2 vertices,
+    // all in one pass per block, into terrain_attributes, which holds the
+    // whole mesh. Only the vertices in region are written, the rest of the
+    // mesh is left as it is, so it may as well be mapped buffer memory.
+    // Previews are laid out row by row, the full resolution mesh like the
+    // maps. Returns false once the token gets cancelled, leaving
+    // terrain_attributes partially written.
+    static bool generate_vertices(
+        const GenerationCache& cache,
+        const unsigned int grid_size,
+        const unsigned int stride,
+        const GenerationSettings& settings,
+        const SampleRegion& region,
+        const CancelToken& cancel,
+        Vertex* terrain_attributes)
+    {
+        const auto& height_map = cache.height_map;
+        const auto& climate_map = cache.climate_map;
+        const auto size = (grid_size - 1) / stride + 1;
 
-        auto inverse_lerp = [](float a, float b, float x) {
-            return (x - a) / (b - a);
+        const auto [min_height, max_height] = height_bounds(height_map, settings);
+
+        // slopes come out per unit of sample space, i.e. per scale cells
+        const auto inverse_range = 1.0f / (settings.scale * (max_height - min_height));
+
+        const auto origin = settings.origin;
+        const auto column_origin = wrap(origin.x, grid_size);
+
+        // Where the maps keep row y and column x of the mesh
+        const auto map_row = [&](unsigned int y) {
+            return wrap(static_cast<int>(y * stride) + origin.y, grid_size);
+        };
+        const auto map_column = [&](unsigned int x) {
+            const auto column = x * stride + column_origin;
+            return column < grid_size ? column : column - grid_size;
         };
 
-        index = 0;
-		for (int y = 0; y < grid_size; y++) {
-			for (int x = 0; x < grid_size; x++) {
-				noise_map[index] = inverse_lerp(min_noise_height, max_noise_height, noise_map[index]);
-                index++;
-			}
-		}
+        for_each_block(region, cancel, [&](const SampleRegion& block) {
+            const auto first_row = block.first_row;
+            const auto end_row = block.end_row;
+
+            // Triangles straddle the block's edge, so the scratch also covers
+            // the column after it, and the column before for the map's last one
+            const auto column_begin = (block.end_column == size && block.first_column > 0) ? block.first_column - 1 : block.first_column;
+            const auto column_end = std::min(block.end_column + 1, size);
+            const auto width = column_end - column_begin;
+            const auto columns = block.end_column - block.first_column;
+
+            // Same for the rows around the block
+            const auto scratch_begin = (end_row == size && first_row > 0) ? first_row - 1 : first_row;
+            const auto scratch_end = std::min(end_row + 1, size);
+            const auto scratch_size = (scratch_end - scratch_begin) * width;
+
+            ScratchFrame frame(*cache.scratch);
+            auto heights = frame.take<float>(scratch_size);
+            auto temperature = frame.take<float>(scratch_size);
+            auto moisture = frame.take<float>(scratch_size);
+
+            for (auto y = scratch_begin; y < scratch_end; y++) {
+                const auto row = (y - scratch_begin) * width;
+                height_map.heights.for_each_run(map_column(column_begin), map_row(y), stride, width, [&](unsigned int first, std::size_t offset, unsigned int count) {
+                    if (stride >= sparse_stride) {
+                        height_map.heights.prefetch_ahead(offset, prefetch_tiles);
+                        climate_map.temperature.prefetch_ahead(offset, prefetch_tiles);
+                        climate_map.moisture.prefetch_ahead(offset, prefetch_tiles);
+                    }
+                    for (unsigned int i = first; i < first + count; i++, offset += stride) {
+                        std::tie(heights[row + i], temperature[row + i], moisture[row + i]) = surface_climate(height_map, climate_map, offset, min_height, max_height);
+                    }
+                });
+            }
+
+            // Structure of arrays for the current row of vertices
+            auto normal_x = frame.take<float>(columns);
+            auto normal_z = frame.take<float>(columns);
+            auto normal_scale = frame.take<float>(columns);
+            auto centroid_heights = frame.take<float>(columns);
+            auto centroid_temperatures = frame.take<float>(columns);
+            auto centroid_moistures = frame.take<float>(columns);
+
+            // Centroids of count triangles whose corners start at the scratch
+            // offsets a, b and c
+            auto centroids = [&](unsigned int a, unsigned int b, unsigned int c, unsigned int first, unsigned int count) {
+                for (unsigned int i = 0; i < count; i++) {
+                    centroid_heights[first + i] = (heights[a + i] + heights[b + i] + heights[c + i]) / 3.0f;
+                    centroid_temperatures[first + i] = (temperature[a + i] + temperature[b + i] + temperature[c + i]) / 3.0f;
+                    centroid_moistures[first + i] = (moisture[a + i] + moisture[b + i] + moisture[c + i]) / 3.0f;
+                }
+            };
+
+            // Scratch offsets of the block's first column and of the map's
+            // last one
+            const auto first = block.first_column - column_begin;
+            const auto last = size - 1 - column_begin;
+            const auto inner_columns = std::min(block.end_column, size - 1) - std::min(block.first_column, size - 1);
 
-		return noise_map;
+            for (auto x = first_row; x < end_row; x++) {
+                const auto row = (x - scratch_begin) * width;
+                const auto ring_row = map_row(x) * grid_size;
+
+                // Normals come straight from the noise derivatives. Vertex x
+                // runs along the height map's rows (y) and z along its columns
+                height_map.slope_x.for_each_run(map_column(block.first_column), map_row(x), stride, columns, [&](unsigned int first_z, std::size_t offset, unsigned int count) {
+                    if (stride >= sparse_stride) {
+                        height_map.slope_x.prefetch_ahead(offset, prefetch_tiles);
+                        height_map.slope_y.prefetch_ahead(offset, prefetch_tiles);
+                    }
+                    for (unsigned int z = first_z; z < first_z + count; z++, offset += stride) {
+                        normal_x[z] = -height_map.slope_y[offset] * inverse_range;
+                        normal_z[z] = -height_map.slope_x[offset] * inverse_range;
+                        normal_scale[z] = 1.0f / std::sqrt(normal_x[z] * normal_x[z] + 1.0f + normal_z[z] * normal_z[z]);
+                    }
+                });
+
+                // Vertices are shared by up to six triangles and take the
+                // colour of the last one in cell order: the second triangle
+                // of their own cell, or of a neighbouring cell along the far
+                // edges of the map
+                if (size > 1) {
+                    if (x + 1 < size) {
+                        centroids(row + width + first + 1, row + first, row + first + 1, 0, inner_columns);
+                        if (block.end_column == size) {
+                            centroids(row + width + last, row + last - 1, row + last, columns - 1, 1);
+                        }
+                    } else {
+                        centroids(row - width + first, row + first + 1, row + first, 0, inner_columns);
+                        if (block.end_column == size) {
+                            centroids(row + last, row - width + last - 1, row - width + last, columns - 1, 1);
+                        }
+                    }
+                }
+
+                for (unsigned int z = 0; z < columns; z++) {
+                    const auto column = block.first_column + z;
+                    const auto index = stride == 1 ? ring_row + map_column(column) : x * size + column;
+
+                    // TODO: Make the water height more realistic
+                    const auto scratch = row + first + z;
+                    auto is_land = heights[scratch] > water_level;
+                    auto height = (is_land ? heights[scratch] : water_level);
+
+                    const auto normal = is_land
+                        ? glm::vec3(normal_x[z], 1.0f, normal_z[z]) * normal_scale[z]
+                        : glm::vec3(0.0f, 1.0f, 0.0f);
+
+                    // A lone vertex has no triangles to take a biome from
+                    // and shows up white
+                    const auto biome = size > 1
+                        ? Biomes::classify(centroid_heights[z], centroid_temperatures[z], centroid_moistures[z])
+                        : Biome::SNOW;
+
+                    terrain_attributes[index] = Vertex::pack(height, normal, biome);
+                }
+            }
+        });
+
+        return !cancel.cancelled();
     }
 
-    VertexBufferObject vbo;
-    VertexBufferObject ebo;
-    unsigned int draw_count;
-    Indices indices;
-    unsigned int grid_size;
+    // Normalised height of the sample stored at offset in the maps, along
+    // with its temperature, cooled on land above the beach line, and its
+    // moisture
+    static std::tuple<float, float, float> surface_climate(
+        const HeightMap& height_map,
+        const ClimateMap& climate_map,
+        const std::size_t offset,
+        const float min_height,
+        const float max_height)
+    {
+        const auto height = std::clamp((height_map.heights[offset] - min_height) / (max_height - min_height), 0.0f, 1.0f);
+        const auto altitude = std::max(height - 0.45f, 0.0f);
+        const auto temperature = std::clamp(climate_map.temperature[offset] - altitude, 0.0f, 1.0f);
+        return { height, temperature, climate_map.moisture[offset] };
+    }
+
+    // Packs every stride-th sample of the cached maps into a level of
+    // ((grid_size - 1) / stride + 1)^2 samples for a height texture, laid
+    // out like generate_vertices lays out vertices. Samples don't depend on
+    // their neighbours, so only the normalisation is left of the vertex
+    // pass. Returns false once the token gets cancelled.
+    static bool generate_samples(
+        const GenerationCache& cache,
+        const unsigned int grid_size,
+        const unsigned int stride,
+        const GenerationSettings& settings,
+        const SampleRegion& region,
+        const CancelToken& cancel,
+        SampleData& samples)
+    {
+        const auto size = (grid_size - 1) / stride + 1;
+        const auto [min_height, max_height] = height_bounds(cache.height_map, settings);
+        const auto row_origin = settings.origin.y;
+        const auto column_origin = wrap(settings.origin.x, grid_size);
+
+        samples.resize(size * size);
+
+        for_each_block(region, cancel, [&](const SampleRegion& block) {
+            const auto columns = block.end_column - block.first_column;
+            const auto first_column = (block.first_column * stride + column_origin) % grid_size;
+            for (auto x = block.first_row; x < block.end_row; x++) {
+                const auto map_row = wrap(static_cast<int>(x * stride) + row_origin, grid_size);
+                cache.height_map.heights.for_each_run(first_column, map_row, stride, columns, [&](unsigned int first, std::size_t offset, unsigned int count) {
+                    if (stride >= sparse_stride) {
+                        cache.height_map.heights.prefetch_ahead(offset, prefetch_tiles);
+                        cache.climate_map.temperature.prefetch_ahead(offset, prefetch_tiles);
+                        cache.climate_map.moisture.prefetch_ahead(offset, prefetch_tiles);
+                    }
+                    for (unsigned int z = first; z < first + count; z++, offset += stride) {
+                        const auto column = block.first_column + z;
+                        const auto index = stride == 1 ? map_row * grid_size + (column + column_origin) % grid_size : x * size + column;
+                        const auto [height, temperature, moisture] = surface_climate(cache.height_map, cache.climate_map, offset, min_height, max_height);
+                        samples[index] = HeightSample::pack(height, temperature, moisture);
+                    }
+                });
+            }
+        });
+
+        return !cancel.cancelled();
+    }
+
+    // Writes the region of a level as vertices or as samples, whichever the
+    // cache's format asks for
+    static bool generate_mesh(
+        const GenerationCache& cache,
+        const unsigned int grid_size,
+        const unsigned int stride,
+        const GenerationSettings& settings,
+        const SampleRegion& region,
+        const CancelToken& cancel,
+        Vertex* vertices,
+        SampleData& samples)
+    {
+        if (cache.format == SampleFormat::HEIGHT_TEXTURE) {
+            return generate_samples(cache, grid_size, stride, settings, region, cancel, samples);
+        }
+        return generate_vertices(cache, grid_size, stride, settings, region, cancel, vertices);
+    }
+
+    // Generation is split into tiles of whole rows, sized so that a tile's
+    // share of each map (about 16K samples) stays in cache
+    static constexpr unsigned int tile_samples = 16 * 1024;
+
+    static unsigned int tile_rows(const unsigned int width) {
+        return std::max(1u, tile_samples / width);
+    }
+
+    static unsigned int tile_count(const SampleRegion& region) {
+        const auto rows = tile_rows(region.end_column - region.first_column);
+        return (region.end_row - region.first_row + rows - 1) / rows;
+    }
+
+    // Runs tile(index, first_row, end_row) for every tile of the region's
+    // rows across all cores. Tiles that haven't started when the token gets
+    // cancelled are skipped.
+    template <typename F>
+    static void for_each_tile(const SampleRegion& region, const CancelToken& cancel, F&& tile) {
+        const auto rows = tile_rows(region.end_column - region.first_column);
+        TaskScheduler::instance().parallel_for(tile_count(region), [&](std::size_t index) {
+            if (cancel.cancelled()) {
+                return;
+            }
+
+            const auto first_row = region.first_row + static_cast<unsigned int>(index) * rows;
+            tile(static_cast<unsigned int>(index), first_row, std::min(first_row + rows, region.end_row));
+        });
+    }
+
+    // Vertices are generated in square blocks instead, so that a block reads
+    // whole tiles of the maps rather than a few samples of every tile along
+    // its rows
+    static constexpr unsigned int block_edge = 128;
+
+    // With tiled maps, from this stride on a block reads only a line or two
+    // of every tile along a row, a page apart, which the hardware
+    // prefetchers don't follow, so its walks along the maps prefetch
+    // prefetch_tiles tiles ahead. Row-major maps don't need it.
+    static constexpr unsigned int sparse_stride = 4;
+    static constexpr unsigned int prefetch_tiles = 8;
+
+    // Runs block(part) for every block of the region across all cores.
+    // Blocks that haven't started when the token gets cancelled are skipped.
+    template <typename F>
+    static void for_each_block(const SampleRegion& region, const CancelToken& cancel, F&& block) {
+        const auto rows = (region.end_row - region.first_row + block_edge - 1) / block_edge;
+        const auto columns = (region.end_column - region.first_column + block_edge - 1) / block_edge;
+        TaskScheduler::instance().parallel_for(rows * columns, [&](std::size_t index) {
+            if (cancel.cancelled()) {
+                return;
+            }
+
+            const auto first_row = region.first_row + static_cast<unsigned int>(index / columns) * block_edge;
+            const auto first_column = region.first_column + static_cast<unsigned int>(index % columns) * block_edge;
+            block(SampleRegion {
+                first_row, std::min(first_row + block_edge, region.end_row),
+                first_column, std::min(first_column + block_edge, region.end_column)
+            });
+        });
+    }
+
+    static SampleRegion whole_map(const unsigned int size) {
+        return SampleRegion { 0, size, 0, size };
+    }
+
+    // The maps, the octave layers and the full resolution mesh are toroidal:
+    // a sample is stored at its world position modulo the grid size, so
+    // panning only overwrites what scrolls into the window. Also gives the
+    // position within a warp lattice cell.
+    static unsigned int wrap(const int position, const unsigned int period) {
+        const auto remainder = position % static_cast<int>(period);
+        return remainder < 0 ? remainder + period : remainder;
+    }
+
+    // Rounds towards negative infinity
+    static int floor_divide(const int position, const unsigned int period) {
+        return (position - static_cast<int>(wrap(position, period))) / static_cast<int>(period);
+    }
+
+    // Each octave's noise, in [-1, 1], is remapped to noise * 2 - 1 as the
+    // original generator did
+    static constexpr float octave_scale = 2.0f;
+    static constexpr float octave_bias = -1.0f;
+
+    // Range the heights are normalised from
+    static std::pair<float, float> height_bounds(const HeightMap& height_map, const GenerationSettings& settings) {
+        if (settings.height_range == HeightRange::OBSERVED) {
+            return { height_map.min_height, height_map.max_height };
+        }
+
+        // Every octave spans [bias - scale, bias + scale] times its
+        // amplitude, with the amplitudes following set_spectrum
+        auto min_height = 0.0f;
+        auto max_height = 0.0f;
+        auto amplitude = 1.0f;
+        for (int octave = 0; octave < settings.octaves; octave++) {
+            const auto low = amplitude * (octave_bias - octave_scale);
+            const auto high = amplitude * (octave_bias + octave_scale);
+            min_height += std::min(low, high);
+            max_height += std::max(low, high);
+            amplitude *= settings.persistence;
+        }
+        return { min_height, max_height };
+    }
+
+    // Evaluates the noise at every stride-th row and column of the map. When
+    // refining, the samples at twice the stride are already there and only
+    // the ones in between get evaluated. The height range is widened to
+    // cover the new samples.
+    //
+    // With an enabled layer cache the octaves are evaluated one at a time
+    // and kept, and the map is their weighted sum, summed in the same order
+    // as the fused kernels so the result is identical. Octaves whose layer
+    // is already complete at this stride are only read back.
+    static void refine_height_map(
+        HeightMap& height_map,
+        const unsigned int grid_size,
+        const GenerationSettings& settings,
+        const WarpField& warp_field,
+        OctaveLayerCache* layer_cache,
+        ScratchArena& scratch,
+        const unsigned int stride,
+        const bool refining,
+        const SampleRegion& region,
+        const CancelToken& cancel)
+    {
+        ScratchFrame frame(scratch);
+
+        // Generate octave noise
+        std::mt19937 gen(settings.seed);
+        std::uniform_int_distribution<> dis(-100000, 100000);
+		auto octave_offsets = frame.take<glm::vec2>(settings.octaves);
+		for (int octave = 0; octave < settings.octaves; octave++) {
+			float offset_x = dis(gen) + settings.offset.x;
+			float offset_y = dis(gen) + settings.offset.y;
+			octave_offsets[octave] = glm::vec2(offset_x, offset_y);
+		}
+
+		float half_width = grid_size / 2.0f;
+		float half_height = grid_size / 2.0f;
+
+        auto base_xs = frame.take<float>(grid_size);
+        for (unsigned int x = 0; x < grid_size; x++) {
+            base_xs[x] = ((static_cast<int>(x) + settings.origin.x) * settings.spacing - half_width) / settings.scale;
+        }
+
+        const auto columns = region.end_column - region.first_column;
+
+        const auto column_origin = wrap(settings.origin.x, grid_size);
+        const auto ring_column = [&](unsigned int x) {
+            const auto column = x + column_origin;
+            return column < grid_size ? column : column - grid_size;
+        };
+
+        const auto warped = !warp_field.samples.empty();
+        const auto warp_width = warp_field.width;
+        const auto warp_cells = warp_spacing(settings);
+
+        // Each tile reduces its own samples; the tiles are combined in order
+        // afterwards so the result doesn't depend on the thread count
+        auto tile_min = frame.take<float>(tile_count(region), std::numeric_limits<float>::max());
+        auto tile_max = frame.take<float>(tile_count(region), std::numeric_limits<float>::lowest());
+
+        // Starting a pass also trims the cache when its budget was lowered
+        if (layer_cache) {
+            layer_cache->begin_pass();
+        }
+
+        const auto layered = layer_cache && layer_cache->enabled();
+        const auto layered_octaves = layered ? std::min(settings.octaves, TerrainGraph<NoiseType::PERLIN_3D, 0>::max_octaves) : 0;
+        auto frequencies = frame.take<float>(layered_octaves);
+        auto amplitudes = frame.take<float>(layered_octaves);
+        auto octave_layers = frame.take<OctaveLayer*>(layered_octaves);
+        auto layer_complete = frame.take<bool>(layered_octaves);
+
+        if (layered) {
+            // same spectrum as Fbm::set_spectrum
+            auto frequency = 1.0f;
+            auto amplitude = 1.0f;
+            for (int octave = 0; octave < layered_octaves; octave++) {
+                frequencies[octave] = frequency;
+                amplitudes[octave] = amplitude;
+                amplitude *= settings.persistence;
+                frequency *= settings.lacunarity;
+
+                const auto layer = layer_cache->acquire(OctaveLayerKey {
+                    settings.seed, settings.scale, settings.lacunarity, settings.offset,
+                    settings.noise_type, settings.lattice_hash, settings.warp_strength, settings.warp_scale,
+                    settings.origin, settings.spacing, grid_size, octave
+                }, stride);
+                octave_layers[octave] = layer;
+                layer_complete[octave] = layer && layer->stride != 0 && layer->stride <= stride;
+            }
+        }
+
+        // All octaves run fused in one pass per row; the graph is picked by
+        // noise type and octave count so common counts get unrolled kernels
+        const auto evaluate_tiles = [&](const auto& graph) {
+            for_each_tile(region, cancel, [&](unsigned int tile, unsigned int first_row, unsigned int end_row) {
+                ScratchFrame tile_frame(scratch);
+                auto sample_xs = tile_frame.take<float>(columns);
+                auto sample_ys = tile_frame.take<float>(columns);
+                auto sample_heights = tile_frame.take<float>(columns);
+                auto sample_slope_x = tile_frame.take<float>(columns);
+                auto sample_slope_y = tile_frame.take<float>(columns);
+                auto coarse_row = tile_frame.take<WarpSample>(warp_width);
+                auto row_warp = tile_frame.take<WarpSample>(columns);
+
+                // Single octave scratch for the layered sum
+                const auto octave_size = layered ? columns : 0;
+                auto octave_xs = tile_frame.take<float>(octave_size);
+                auto octave_ys = tile_frame.take<float>(octave_size);
+                auto octave_heights = tile_frame.take<float>(octave_size);
+                auto octave_slope_x = tile_frame.take<float>(octave_size);
+                auto octave_slope_y = tile_frame.take<float>(octave_size);
+
+                for (auto row = first_row; row < end_row; row++) {
+                    const int y = row * stride;
+                    const int world_y = (y + settings.origin.y) * settings.spacing;
+                    float base_y = (world_y - half_height) / settings.scale;
+                    const auto ring_y = wrap(y + settings.origin.y, grid_size);
+
+                    // Rows shared with the coarser level only need the
+                    // columns in between its samples
+                    const auto first_column = region.first_column + ((refining && row % 2 == 0) ? 1u : 0u);
+                    const auto column_step = (refining && row % 2 == 0) ? 2u : 1u;
+                    const auto count = (region.end_column - first_column + column_step - 1) / column_step;
+
+                    // Where the row's samples are kept in the map and the
+                    // octave layers
+                    const auto first_sample = ring_column(first_column * stride);
+                    const auto sample_step = column_step * stride;
+
+                    const auto heights = sample_heights.data();
+                    const auto row_slope_x = sample_slope_x.data();
+                    const auto row_slope_y = sample_slope_y.data();
+
+                    if (warped) {
+                        // bilinear interpolation of the coarse warp lattice
+                        auto coarse_y = floor_divide(world_y, warp_cells) - warp_field.first_y;
+                        auto t_y = float(wrap(world_y, warp_cells)) / warp_cells;
+                        for (unsigned int i = 0; i < warp_width; i++) {
+                            coarse_row[i] = interpolate(warp_field.samples[coarse_y * warp_width + i], warp_field.samples[(coarse_y + 1) * warp_width + i], t_y);
+                        }
+
+                        for (unsigned int i = 0; i < count; i++) {
+                            const auto x = (first_column + i * column_step) * stride;
+                            const int world_x = (static_cast<int>(x) + settings.origin.x) * settings.spacing;
+                            auto coarse_x = floor_divide(world_x, warp_cells) - warp_field.first_x;
+                            row_warp[i] = interpolate(coarse_row[coarse_x], coarse_row[coarse_x + 1], float(wrap(world_x, warp_cells)) / warp_cells);
+                            sample_xs[i] = base_xs[x] + row_warp[i].x;
+                            sample_ys[i] = base_y + row_warp[i].y;
+                        }
+                    } else {
+                        for (unsigned int i = 0; i < count; i++) {
+                            sample_xs[i] = base_xs[(first_column + i * column_step) * stride];
+                        }
+                        std::fill(sample_ys.begin(), sample_ys.begin() + count, base_y);
+                    }
+
+                    if (layered) {
+                        std::fill(heights, heights + count, 0.0f);
+                        std::fill(row_slope_x, row_slope_x + count, 0.0f);
+                        std::fill(row_slope_y, row_slope_y + count, 0.0f);
+
+                        for (int octave = 0; octave < layered_octaves; octave++) {
+                            const auto layer = octave_layers[octave];
+
+                            const auto values = octave_heights.data();
+                            const auto slope_x = octave_slope_x.data();
+                            const auto slope_y = octave_slope_y.data();
+
+                            if (layer_complete[octave]) {
+                                layer->values.for_each_run(first_sample, ring_y, sample_step, count, [&](unsigned int first, std::size_t offset, unsigned int n) {
+                                    for (unsigned int i = first; i < first + n; i++, offset += sample_step) {
+                                        values[i] = layer->values[offset];
+                                        slope_x[i] = layer->slope_x[offset];
+                                        slope_y[i] = layer->slope_y[offset];
+                                    }
+                                });
+                            } else {
+                                for (unsigned int i = 0; i < count; i++) {
+                                    octave_xs[i] = sample_xs[i] * frequencies[octave] + octave_offsets[octave].x;
+                                    octave_ys[i] = sample_ys[i] * frequencies[octave] + octave_offsets[octave].y;
+                                }
+
+                                NoiseGraph::evaluate_gradient(
+                                    graph, octave_xs.data(), octave_ys.data(),
+                                    values, slope_x, slope_y,
+                                    count, settings.seed + octave);
+
+                                if (layer) {
+                                    layer->values.for_each_run(first_sample, ring_y, sample_step, count, [&](unsigned int first, std::size_t offset, unsigned int n) {
+                                        for (unsigned int i = first; i < first + n; i++, offset += sample_step) {
+                                            layer->values[offset] = values[i];
+                                            layer->slope_x[offset] = slope_x[i];
+                                            layer->slope_y[offset] = slope_y[i];
+                                        }
+                                    });
+                                }
+                            }
+
+                            const auto amplitude = amplitudes[octave];
+                            const auto slope_scale = amplitude * frequencies[octave];
+                            for (unsigned int i = 0; i < count; i++) {
+                                heights[i] += values[i] * amplitude;
+                                row_slope_x[i] += slope_x[i] * slope_scale;
+                                row_slope_y[i] += slope_y[i] * slope_scale;
+                            }
+                        }
+                    } else {
+                        NoiseGraph::evaluate_gradient(
+                            graph, sample_xs.data(), sample_ys.data(),
+                            heights, row_slope_x, row_slope_y,
+                            count, settings.seed);
+                    }
+
+                    if (warped) {
+                        // chain rule through the warped sample position
+                        for (unsigned int i = 0; i < count; i++) {
+                            const auto& w = row_warp[i];
+                            float slope_x = row_slope_x[i];
+                            float slope_y = row_slope_y[i];
+                            row_slope_x[i] = slope_x * (1.0f + w.x_dx) + slope_y * w.y_dx;
+                            row_slope_y[i] = slope_x * w.x_dy + slope_y * (1.0f + w.y_dy);
+                        }
+                    }
+
+                    for (unsigned int i = 0; i < count; i++) {
+                        tile_min[tile] = std::min(tile_min[tile], heights[i]);
+                        tile_max[tile] = std::max(tile_max[tile], heights[i]);
+                    }
+
+                    height_map.heights.for_each_run(first_sample, ring_y, sample_step, count, [&](unsigned int first, std::size_t offset, unsigned int n) {
+                        for (unsigned int i = first; i < first + n; i++, offset += sample_step) {
+                            height_map.heights[offset] = heights[i];
+                            height_map.slope_x[offset] = row_slope_x[i];
+                            height_map.slope_y[offset] = row_slope_y[i];
+                        }
+                    });
+                }
+            });
+        };
+
+        const auto evaluate_type = [&](auto type) {
+            if (layered) {
+                // One octave at unit frequency; the layered sum scales and
+                // offsets the samples itself
+                TerrainGraph<decltype(type)::value, 1> graph;
+                graph.node.node.hash = settings.lattice_hash;
+                graph.node.scale = octave_scale;
+                graph.node.bias = octave_bias;
+                graph.set_spectrum(1.0f, 1.0f);
+                evaluate_tiles(graph);
+                return;
+            }
+
+            with_unrolled_octaves(settings.octaves, [&](auto octaves) {
+                TerrainGraph<decltype(type)::value, decltype(octaves)::value> graph;
+                graph.node.node.hash = settings.lattice_hash;
+                graph.node.scale = octave_scale;
+                graph.node.bias = octave_bias;
+                graph.octaves = settings.octaves;
+                graph.set_spectrum(settings.lacunarity, settings.persistence);
+                for (int i = 0; i < settings.octaves && i < graph.max_octaves; i++) {
+                    graph.offset_x[i] = octave_offsets[i].x;
+                    graph.offset_y[i] = octave_offsets[i].y;
+                }
+                evaluate_tiles(graph);
+            });
+        };
+
+        switch (settings.noise_type) {
+            case NoiseType::PERLIN_3D:
+                evaluate_type(std::integral_constant<NoiseType, NoiseType::PERLIN_3D>());
+                break;
+            case NoiseType::PERLIN_2D:
+                evaluate_type(std::integral_constant<NoiseType, NoiseType::PERLIN_2D>());
+                break;
+            case NoiseType::SIMPLEX_2D:
+                evaluate_type(std::integral_constant<NoiseType, NoiseType::SIMPLEX_2D>());
+                break;
+        }
+
+        // Layers that were missing samples are complete now if this pass
+        // evaluated every one at the stride, or the ones the level before
+        // left out
+        if (layered && !cancel.cancelled()) {
+            for (int octave = 0; octave < layered_octaves; octave++) {
+                const auto layer = octave_layers[octave];
+                if (layer && !layer_complete[octave] && (!refining || layer->stride == stride * 2)) {
+                    layer->stride = stride;
+                }
+            }
+        }
+
+        height_map.min_height = std::min(height_map.min_height, *std::min_element(tile_min.begin(), tile_min.end()));
+        height_map.max_height = std::max(height_map.max_height, *std::max_element(tile_max.begin(), tile_max.end()));
+    }
+
+    // Climate varies over much larger distances than the terrain itself
+    static constexpr float biome_scale = 6.0f;
+    static constexpr int biome_octaves = 3;
+
+    // Separate offsets from the terrain octaves so climate doesn't line up
+    // with the elevation features
+    static std::array<glm::vec2, biome_octaves> generate_climate_offsets(const GenerationSettings& settings) {
+        std::mt19937 gen(settings.seed + 1);
+        std::uniform_int_distribution<> dis(-100000, 100000);
+        std::array<glm::vec2, biome_octaves> octave_offsets;
+        for (auto& offset : octave_offsets) {
+            float offset_x = dis(gen) + settings.offset.x;
+            float offset_y = dis(gen) + settings.offset.y;
+            offset = glm::vec2(offset_x, offset_y);
+        }
+
+        return octave_offsets;
+    }
+
+    // Temperature and moisture fBm at every stride-th row and column of the
+    // map, refining the samples at twice the stride like refine_height_map.
+    // Both are evaluated in one multi-channel noise call per octave so they
+    // share the lattice work.
+    static void refine_climate_map(
+        ClimateMap& climate_map,
+        const unsigned int grid_size,
+        const GenerationSettings& settings,
+        ScratchArena& scratch,
+        const unsigned int stride,
+        const bool refining,
+        const SampleRegion& region,
+        const CancelToken& cancel)
+    {
+        const auto octave_offsets = generate_climate_offsets(settings);
+        const auto half_size = grid_size / 2.0f;
+        const auto scale = settings.scale * biome_scale;
+        const auto columns = region.end_column - region.first_column;
+        const auto column_origin = wrap(settings.origin.x, grid_size);
+
+        for_each_tile(region, cancel, [&](unsigned int, unsigned int first_row, unsigned int end_row) {
+            ScratchFrame frame(scratch);
+            auto sample_xs = frame.take<float>(columns);
+            auto sample_ys = frame.take<float>(columns);
+            auto temperature = frame.take<float>(columns);
+            auto moisture = frame.take<float>(columns);
+            auto temperature_sum = frame.take<float>(columns);
+            auto moisture_sum = frame.take<float>(columns);
+            float* channels[] = { temperature.data(), moisture.data() };
+
+            for (auto row = first_row; row < end_row; row++) {
+                const int sample_y = static_cast<int>(row * stride) + settings.origin.y;
+                const int world_y = sample_y * settings.spacing;
+                const auto ring_y = wrap(sample_y, grid_size);
+                const auto first_column = region.first_column + ((refining && row % 2 == 0) ? 1u : 0u);
+                const auto column_step = (refining && row % 2 == 0) ? 2u : 1u;
+                const auto count = (region.end_column - first_column + column_step - 1) / column_step;
+
+                std::fill(temperature_sum.begin(), temperature_sum.end(), 0.0f);
+                std::fill(moisture_sum.begin(), moisture_sum.end(), 0.0f);
+
+                float amplitude = 1.0f;
+                float frequency = 1.0f;
+                float total_amplitude = 0.0f;
+
+                for (int i = 0; i < biome_octaves; i++) {
+                    for (unsigned int column = 0; column < count; column++) {
+                        const int world_x = (static_cast<int>((first_column + column * column_step) * stride) + settings.origin.x) * settings.spacing;
+                        sample_xs[column] = (world_x - half_size) / scale * frequency + octave_offsets[i].x;
+                        sample_ys[column] = (world_y - half_size) / scale * frequency + octave_offsets[i].y;
+                    }
+
+                    NoiseBatch::perlin2_channels(
+                        sample_xs.data(), sample_ys.data(), channels, 2, count,
+                        settings.lattice_hash, settings.seed + 1000 + i);
+
+                    for (unsigned int column = 0; column < count; column++) {
+                        temperature_sum[column] += temperature[column] * amplitude;
+                        moisture_sum[column] += moisture[column] * amplitude;
+                    }
+
+                    total_amplitude += amplitude;
+                    amplitude *= 0.5f;
+                    frequency *= 2.0f;
+                }
+
+                // [-1, 1] -> [0, 1]
+                const auto column_index = first_column * stride + column_origin;
+                const auto first_sample = column_index < grid_size ? column_index : column_index - grid_size;
+                climate_map.temperature.for_each_run(first_sample, ring_y, column_step * stride, count, [&](unsigned int first, std::size_t offset, unsigned int n) {
+                    for (unsigned int column = first; column < first + n; column++, offset += column_step * stride) {
+                        climate_map.temperature[offset] = 0.5f + 0.5f * temperature_sum[column] / total_amplitude;
+                        climate_map.moisture[offset] = std::clamp(0.5f + 0.5f * moisture_sum[column] / total_amplitude, 0.0f, 1.0f);
+                    }
+                });
+            }
+        });
+    }
+
+    // Warps displace the terrain slowly, so they are evaluated only every
+    // warp_step cells and interpolated
+    static constexpr unsigned int warp_step = 4;
+
+    // Cells between the warp lattice points. Sparser samples use a lattice
+    // through every sample instead; the lattices share the points of the
+    // coarser one, so samples of every spacing agree wherever they meet.
+    static unsigned int warp_spacing(const GenerationSettings& settings) {
+        return std::max(warp_step, static_cast<unsigned int>(settings.spacing));
+    }
+
+    // Fills field with the displacements on the lattice points spaced
+    // warp_spacing cells apart around a full resolution region of the
+    // window, row-major, scaled by the warp strength. The samples reuse the
+    // field's memory.
+    static void generate_warp_field(
+        const unsigned int grid_size,
+        const GenerationSettings& settings,
+        const SampleRegion& region,
+        ScratchArena& scratch,
+        WarpField& field)
+    {
+        const auto spacing = settings.spacing;
+        const auto lattice = warp_spacing(settings);
+        const auto first_x = floor_divide((static_cast<int>(region.first_column) + settings.origin.x) * spacing, lattice);
+        const auto first_y = floor_divide((static_cast<int>(region.first_row) + settings.origin.y) * spacing, lattice);
+        const auto width = static_cast<unsigned int>(floor_divide((static_cast<int>(region.end_column - 1) + settings.origin.x) * spacing, lattice) - first_x + 2);
+        const auto height = static_cast<unsigned int>(floor_divide((static_cast<int>(region.end_row - 1) + settings.origin.y) * spacing, lattice) - first_y + 2);
+        const auto half_size = grid_size / 2.0f;
+        const auto strength = settings.warp_strength;
+        const auto frequency = settings.warp_scale;
+
+        // the y displacement reads the same field further along, see DomainWarp
+        const auto offset = DomainWarp<TerrainWarpGraph, TerrainWarpGraph>::offset;
+
+        TerrainWarpGraph graph;
+        graph.node.hash = settings.lattice_hash;
+        graph.set_spectrum(2.0f, 0.5f);
+
+        ScratchFrame frame(scratch);
+        auto xs = frame.take<float>(width);
+        auto shifted_xs = frame.take<float>(width);
+        for (unsigned int i = 0; i < width; i++) {
+            xs[i] = ((first_x + static_cast<int>(i)) * static_cast<int>(lattice) - half_size) / settings.scale * frequency;
+            shifted_xs[i] = xs[i] + offset;
+        }
+
+        field.samples.resize(width * height);
+        field.first_x = first_x;
+        field.first_y = first_y;
+        field.width = width;
+
+        TaskScheduler::instance().parallel_for(height, [&](std::size_t j) {
+            ScratchFrame row_frame(scratch);
+            auto ys = row_frame.take<float>(width);
+            auto shifted_ys = row_frame.take<float>(width);
+            auto warp_x = row_frame.take<float>(width);
+            auto warp_x_dx = row_frame.take<float>(width);
+            auto warp_x_dy = row_frame.take<float>(width);
+            auto warp_y = row_frame.take<float>(width);
+            auto warp_y_dx = row_frame.take<float>(width);
+            auto warp_y_dy = row_frame.take<float>(width);
+
+            const auto y = ((first_y + static_cast<int>(j)) * static_cast<int>(lattice) - half_size) / settings.scale * frequency;
+            std::fill(ys.begin(), ys.end(), y);
+            std::fill(shifted_ys.begin(), shifted_ys.end(), y + offset);
+
+            NoiseGraph::evaluate_gradient(graph, xs.data(), ys.data(), warp_x.data(), warp_x_dx.data(), warp_x_dy.data(), width, settings.seed + 1);
+            NoiseGraph::evaluate_gradient(graph, shifted_xs.data(), shifted_ys.data(), warp_y.data(), warp_y_dx.data(), warp_y_dy.data(), width, settings.seed + 2);
+
+            // derivatives are taken along the unscaled sample position
+            const auto slope = strength * frequency;
+            for (unsigned int i = 0; i < width; i++) {
+                field.samples[j * width + i] = WarpSample {
+                    strength * warp_x[i],
+                    strength * warp_y[i],
+                    slope * warp_x_dx[i],
+                    slope * warp_x_dy[i],
+                    slope * warp_y_dx[i],
+                    slope * warp_y_dy[i]
+                };
+            }
+        });
+    }
+
+    void generation_loop() {
+        // Index of the buffer this thread writes into next
+        unsigned int back = 1;
+        auto cache = empty_cache(grid_size, scratch_arena, sample_format);
+        cache.layers = &layer_cache;
+
+        // What each region of the vertex stream is missing of the full
+        // resolution mesh in the cache. A height texture has just the one
+        // target, the texture, tracked in the first.
+        std::array<PendingRanges, stream_regions> pending;
+        std::vector<VertexRange> changed;
+
+        std::unique_lock<std::mutex> lock(request_mutex);
+        while (true) {
+            request_ready.wait(lock, [&] { return stopping || has_request; });
+            if (stopping) {
+                return;
+            }
+
+            const auto settings = requested_settings;
+            const auto cancel = CancelToken { &latest_request, latest_request.load() };
+            has_request = false;
+            lock.unlock();
+
+            try {
+                changed.clear();
+                if (holds_terrain(cache, settings)) {
+                    // Only the triangulation changed, which goes with the
+                    // whole mesh
+                    changed.push_back(VertexRange { 0, std::size_t(grid_size) * grid_size });
+                    publish_pan(cache, settings, changed, back, pending, cancel);
+                } else if (pan_terrain(cache, grid_size, settings, changed)) {
+                    publish_pan(cache, settings, changed, back, pending, cancel);
+                } else {
+                    // Nothing holds the new mesh yet
+                    pending.fill(PendingRanges { {}, true });
+
+                    const auto& mesh = cache.mesh;
+                    const auto& samples = cache.samples;
+                    generate_terrain_levels(cache, grid_size, settings, cancel, [&](const CancelToken& token) {
+                        auto* update = acquire_buffer(back, token);
+                        if (update) {
+                            update->ranges.clear();
+                            update->origin = settings.origin;
+                            update->spacing = settings.spacing;
+                        }
+                        return update;
+                    }, [&](unsigned int stride) {
+                        auto& update = buffers[back];
+                        update.indices.clear();
+                        if (stride == 1 && sample_format == SampleFormat::HEIGHT_TEXTURE) {
+                            triangulate(rtin, grid_size, samples, settings, update.indices);
+                        } else if (stride == 1) {
+                            triangulate(rtin, grid_size, mesh, settings, update.indices);
+                            pending[back] = PendingRanges {};
+                        }
+                        publish_buffer(back, pending);
+                    });
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> error_lock(error_mutex);
+                generation_error = std::current_exception();
+            }
+
+            lock.lock();
+        }
+    }
+
+    // Publishes the vertices a pan changed, along with whatever else of the
+    // mesh the back buffer's target is missing. A region of the vertex
+    // stream misses every change since it was last written; the height
+    // texture only the updates the renderer hasn't taken yet. Only the
+    // generation thread sets the fresh flag, so once it is seen clear every
+    // earlier update has been taken; if the renderer takes one right after
+    // the check, it merely uploads a few samples twice. Nothing is published
+    // when the token gets cancelled while the back buffer's region is in
+    // use, the changes just stay pending.
+    void publish_pan(
+        const GenerationCache& cache,
+        const GenerationSettings& settings,
+        const std::vector<VertexRange>& changed,
+        unsigned int& back,
+        std::array<PendingRanges, stream_regions>& pending,
+        const CancelToken& cancel)
+    {
+        const auto texture = cache.format == SampleFormat::HEIGHT_TEXTURE;
+        if (texture && !(mailbox.load() & fresh_mesh)) {
+            pending[0] = PendingRanges {};
+        }
+
+        for (std::size_t i = 0; i < (texture ? 1 : pending.size()); i++) {
+            if (!pending[i].all) {
+                pending[i].ranges.insert(pending[i].ranges.end(), changed.begin(), changed.end());
+                merge_ranges(pending[i].ranges);
+            }
+        }
+
+        auto* update = acquire_buffer(back, cancel);
+        if (!update) {
+            return;
+        }
+
+        auto& missing = pending[texture ? 0 : back];
+        missing.all = missing.all || (missing.ranges.size() == 1 && missing.ranges[0].count == std::size_t(grid_size) * grid_size);
+        update->origin = settings.origin;
+        update->spacing = settings.spacing;
+        update->ranges.clear();
+        if (!missing.all) {
+            update->ranges = missing.ranges;
+        }
+
+        if (texture) {
+            pack_ranges(cache.samples, update->ranges, update->samples);
+            triangulate(rtin, grid_size, cache.samples, settings, update->indices);
+        } else {
+            // A mapped region is brought up to date in place, after which
+            // it holds the whole mesh
+            update->vertex_count = cache.mesh.size();
+            if (update->region && update->ranges.empty()) {
+                std::copy(cache.mesh.begin(), cache.mesh.end(), update->region);
+            } else if (update->region) {
+                for (const auto& range : update->ranges) {
+                    std::copy_n(cache.mesh.begin() + range.first, range.count, update->region + range.first);
+                }
+                update->ranges.clear();
+            } else {
+                pack_ranges(cache.mesh, update->ranges, update->vertices);
+            }
+            triangulate(rtin, grid_size, cache.mesh, settings, update->indices);
+            missing = PendingRanges {};
+        }
+
+        publish_buffer(back, pending);
+    }
+
+    // Sorts ranges and merges the overlapping and touching ones, so every
+    // vertex is sent once
+    static void merge_ranges(std::vector<VertexRange>& ranges) {
+        std::sort(ranges.begin(), ranges.end(), [](const VertexRange& a, const VertexRange& b) {
+            return a.first < b.first;
+        });
+
+        std::size_t merged = 0;
+        for (const auto& range : ranges) {
+            if (merged > 0 && range.first <= ranges[merged - 1].first + ranges[merged - 1].count) {
+                auto& last = ranges[merged - 1];
+                last.count = std::max(last.count, range.first + range.count - last.first);
+            } else {
+                ranges[merged++] = range;
+            }
+        }
+        ranges.resize(merged);
+    }
+
+    // Waits until the GPU is done with the back buffer's region of the
+    // vertex stream, which the renderer notices on its next frame, and
+    // returns the buffer. Returns null once the token gets cancelled.
+    MeshUpdate* acquire_buffer(const unsigned int back, const CancelToken& cancel) {
+        if (sample_format == SampleFormat::VERTICES) {
+            std::unique_lock<std::mutex> lock(region_mutex);
+            region_freed.wait(lock, [&] { return cancel.cancelled() || !(busy_regions & (1u << back)); });
+            if (cancel.cancelled()) {
+                return nullptr;
+            }
+        }
+        return &buffers[back];
+    }
+
+    // Swaps the back buffer into the mailbox. Staged vertices only reach
+    // their region once the renderer takes them, so a buffer that comes
+    // back unread leaves its region missing them still.
+    void publish_buffer(unsigned int& back, std::array<PendingRanges, stream_regions>& pending) {
+        const auto previous = mailbox.exchange(back | fresh_mesh);
+        back = previous & ~fresh_mesh;
+
+        const auto& unread = buffers[back];
+        if ((previous & fresh_mesh) && sample_format == SampleFormat::VERTICES && !unread.region) {
+            auto& missing = pending[back];
+            missing.all = missing.all || unread.ranges.empty();
+            if (!missing.all) {
+                missing.ranges.insert(missing.ranges.end(), unread.ranges.begin(), unread.ranges.end());
+                merge_ranges(missing.ranges);
+            }
+        }
+    }
+
+    // Wakes the generation thread wherever it waits, once stopping or
+    // latest_request has changed. Taking the region lock first makes sure
+    // a wait that has just checked the token is asleep to be woken.
+    void wake_generation() {
+        request_ready.notify_one();
+        {
+            std::lock_guard<std::mutex> lock(region_mutex);
+        }
+        region_freed.notify_all();
+    }
+
+    // Copies the ranges of mesh into packed, in order, or the whole mesh
+    // without any
+    template <typename T>
+    static void pack_ranges(const std::vector<T>& mesh, const std::vector<VertexRange>& ranges, std::vector<T>& packed) {
+        if (ranges.empty()) {
+            packed = mesh;
+            return;
+        }
+
+        packed.clear();
+        for (const auto& range : ranges) {
+            packed.insert(packed.end(), mesh.begin() + range.first, mesh.begin() + range.first + range.count);
+        }
+    }
+
+    // True when the cache holds the finished full resolution terrain for
+    // settings, leaving nothing to generate
+    static bool holds_terrain(const GenerationCache& cache, const GenerationSettings& settings) {
+        return cache.mesh_complete &&
+               cache.noise_stride == 1 &&
+               cache.climate_stride == 1 &&
+               cache.mesh_range == settings.height_range &&
+               cache.noise_settings.same_noise_inputs(settings) &&
+               cache.climate_settings.same_climate_inputs(settings);
+    }
+
+    // Replaces triangles with an adaptive triangulation of the full
+    // resolution ring, generated for settings, when they allow any error
+    // and clears them otherwise. The triangles are measured in window
+    // samples and point at the ring's vertices, so panning keeps updating
+    // only the vertices that change.
+    template <typename T>
+    static void triangulate(
+        Rtin& rtin,
+        const unsigned int grid_size,
+        const std::vector<T>& mesh,
+        const GenerationSettings& settings,
+        Indices& triangles)
+    {
+        triangles.clear();
+        if (settings.mesh_error <= 0.0f || grid_size < 2) {
+            return;
+        }
+
+        const auto ring_index = [&](unsigned int x, unsigned int z) {
+            return wrap(static_cast<int>(x) + settings.origin.y, grid_size) * grid_size + wrap(static_cast<int>(z) + settings.origin.x, grid_size);
+        };
+        rtin.update([&](unsigned int x, unsigned int z) {
+            return surface_height(mesh[ring_index(x, z)]);
+        });
+        rtin.extract(settings.mesh_error, triangles, ring_index);
+    }
+
+    // Height drawn at a vertex, which samples only know once the shader
+    // floods them
+    static float surface_height(const Vertex& vertex) {
+        return vertex.unpacked_height();
+    }
+
+    static float surface_height(const HeightSample& sample) {
+        return std::max(sample.unpacked_height(), water_level);
+    }
+
+    // Takes the newest finished mesh from the mailbox, if there is one, and
+    // hands the previously drawn buffer back in exchange. Its region of the
+    // vertex stream stays busy until the draws issued so far are done.
+    void upload_finished_terrain() {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (generation_error) {
+                std::rethrow_exception(std::exchange(generation_error, nullptr));
+            }
+        }
+
+        if (sample_format == SampleFormat::VERTICES) {
+            release_regions();
+        }
+
+        if (!(mailbox.load() & fresh_mesh)) {
+            return;
+        }
+
+        if (sample_format == SampleFormat::VERTICES) {
+            vertex_stream.retire(front);
+            std::lock_guard<std::mutex> lock(region_mutex);
+            busy_regions |= 1u << front;
+        }
+        front = mailbox.exchange(front) & ~fresh_mesh;
+        const auto& update = buffers[front];
+
+        // Levels differ in vertex count, which picks the indices to draw.
+        // Partial updates always go to the full resolution mesh.
+        const auto vertex_count = update.ranges.empty() ? update.size() : grid_size * grid_size;
+        for (const auto& level : levels) {
+            if (level.size * level.size == vertex_count) {
+                draw_count = level.cells.count();
+                first_index = level.cells.first_index();
+                drawn_size = level.size;
+                drawn_stride = level.stride;
+            }
+        }
+
+        vao.bind();
+        if (sample_format == SampleFormat::HEIGHT_TEXTURE) {
+            upload_samples(update);
+        } else {
+            upload_vertices(update);
+        }
+
+        // The element buffer stays bound to the vertex array
+        adaptive_count = 0;
+        if (!update.indices.empty()) {
+            ebo.bind();
+            ebo.update_indices(update.indices, adaptive_first, index_type, narrowed_indices);
+            adaptive_count = update.indices.size();
+        }
+        vao.unbind();
+
+        front_origin = update.origin;
+        front_spacing = update.spacing;
+        ring_drawn = grid_size > 1 && vertex_count == grid_size * grid_size;
+        if (ring_drawn) {
+            build_ring_draws();
+        }
+    }
+
+    // Hands the regions of the vertex stream the GPU has finished with back
+    // to the generation thread. Only polls, so a frame never waits on the
+    // GPU.
+    void release_regions() {
+        unsigned int busy = 0;
+        {
+            std::lock_guard<std::mutex> lock(region_mutex);
+            busy = busy_regions;
+        }
+
+        unsigned int freed = 0;
+        for (unsigned int region = 0; region < stream_regions; region++) {
+            if ((busy & (1u << region)) && vertex_stream.available(region)) {
+                freed |= 1u << region;
+            }
+        }
+        if (freed == 0) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(region_mutex);
+            busy_regions &= ~freed;
+        }
+        region_freed.notify_all();
+    }
+
+    // Points the vertex attributes at the front buffer's region, copying
+    // its staged vertices in first unless they were written in place. The
+    // region is known to be done with, so it is mapped without waiting, and
+    // ranges share one mapping over the part they span.
+    void upload_vertices(const MeshUpdate& update) {
+        auto& vbo = vertex_stream.vbo;
+        vbo.bind();
+        if (!update.region && update.ranges.empty()) {
+            const auto bytes = sizeof(Vertex) * update.vertex_count;
+            std::memcpy(vertex_stream.map(front, 0, bytes, true), update.vertices.data(), bytes);
+            vertex_stream.unmap();
+        } else if (!update.region) {
+            const auto first = update.ranges.front().first;
+            const auto end = update.ranges.back().first + update.ranges.back().count;
+            auto* span = static_cast<Vertex*>(vertex_stream.map(front, sizeof(Vertex) * first, sizeof(Vertex) * (end - first), false));
+            std::size_t packed = 0;
+            for (const auto& range : update.ranges) {
+                std::copy_n(update.vertices.begin() + packed, range.count, span + range.first - first);
+                packed += range.count;
+            }
+            vertex_stream.unmap();
+        }
+        enable_vertex_attributes(vbo, 0, 1, front * grid_size * grid_size);
+        vbo.unbind();
+    }
+
+    // Sends an update's samples to the height texture, whose texel x, y
+    // holds vertex y * size + x. A whole level replaces the texture, or
+    // just its texels when the size is unchanged. Ranges are cut into runs
+    // of a row or of whole rows, and runs of the same columns on the rows
+    // that follow, as the columns a pan brings in, go together as one
+    // rectangle.
+    void upload_samples(const MeshUpdate& update) {
+        sample_texture.bind(sample_unit);
+        if (update.ranges.empty()) {
+            if (texture_size == drawn_size) {
+                sample_texture.update_data(TexelFormat::RGBA8UI, 0, 0, drawn_size, drawn_size, update.samples.data());
+            } else {
+                sample_texture.send_data(TexelFormat::RGBA8UI, drawn_size, drawn_size, 1, update.samples.data());
+                texture_size = drawn_size;
+            }
+            return;
+        }
+
+        // Texels column, row to column + width, row + rows, read from
+        // update.samples[packed] on
+        std::size_t column = 0, row = 0, width = 0, rows = 0, packed = 0;
+        const auto flush = [&]() {
+            if (rows > 0) {
+                sample_texture.update_data(TexelFormat::RGBA8UI, column, row, width, rows, &update.samples[packed]);
+            }
+        };
+
+        auto next = std::size_t(0);
+        for (const auto& range : update.ranges) {
+            for (auto first = range.first; first < range.first + range.count;) {
+                const auto left = range.first + range.count - first;
+                const auto run_column = first % grid_size;
+                const auto run_rows = run_column == 0 ? std::max<std::size_t>(left / grid_size, 1) : 1;
+                const auto run_width = run_rows > 1 || left >= grid_size - run_column ? grid_size - run_column : left;
+                if (run_column == column && run_width == width && first / grid_size == row + rows) {
+                    rows += run_rows;
+                } else {
+                    flush();
+                    column = run_column;
+                    row = first / grid_size;
+                    width = run_width;
+                    rows = run_rows;
+                    packed = next;
+                }
+                next += run_width * run_rows;
+                first += run_width * run_rows;
+            }
+        }
+        flush();
+    }
+
+    // Runs of ring cells to draw, leaving out the row and column of cells
+    // that would join the window's last samples back to its first. A row of
+    // a band without the seam column continues straight into the next one,
+    // so most bands take two runs, either side of the seam row. Strips
+    // either side of the seam column meet in the buffer, so only runs
+    // reaching the end of their band are continued.
+    void build_ring_draws() {
+        const auto seam_row = wrap(front_origin.y - 1, grid_size);
+        const auto seam_column = wrap(front_origin.x - 1, grid_size);
+        const auto& cells = levels.back().cells;
+
+        ring_counts.clear();
+        ring_offsets.clear();
+        std::size_t run_end = 0;
+        const auto add_run = [&](unsigned int row, unsigned int first, unsigned int end, bool ends_band) {
+            if (first == end) {
+                run_end = 0;
+                return;
+            }
+            const auto [span_first, span_end] = cells.span(row, first, end);
+            if (!ring_counts.empty() && run_end == span_first) {
+                ring_counts.back() += static_cast<GLsizei>(span_end - span_first);
+            } else {
+                ring_counts.push_back(static_cast<GLsizei>(span_end - span_first));
+                ring_offsets.push_back(reinterpret_cast<const void *>(span_first * type_size(index_type)));
+            }
+            run_end = ends_band ? span_end : 0;
+        };
+
+        for (unsigned int band = 0; band < cells.bands(); band++) {
+            const auto [first, end] = cells.band_columns(band);
+            for (unsigned int row = 0; row < grid_size; row++) {
+                if (row == seam_row) {
+                    continue;
+                }
+                if (seam_column < first || seam_column >= end) {
+                    add_run(row, first, end, true);
+                } else {
+                    add_run(row, first, seam_column, false);
+                    add_run(row, seam_column + 1, end, true);
+                }
+            }
+        }
+    }
+
+    // Vertices of the three mailbox buffers, each in its own region
+    StreamingBuffer vertex_stream;
+    VertexBufferObject ebo;
+
+    // Samples of the level drawn and the biome of every cell of climate,
+    // used in place of the vertex buffer with a height texture
+    TextureObject sample_texture;
+    TextureObject biome_texture;
+    SampleFormat sample_format;
+    unsigned int texture_size;
+    static constexpr unsigned int sample_unit = 0;
+    static constexpr unsigned int biome_unit = 1;
+    static constexpr std::size_t biome_cells = 64;
+
+    std::size_t draw_count;
+    std::size_t first_index;
+    // Vertices along a side of the level drawn, and the samples between them
+    unsigned int drawn_size;
+    unsigned int drawn_stride;
+    std::vector<MeshLevel> levels;
+    unsigned int grid_size;
+    // Indices are 16 bits wide when the full resolution mesh allows it;
+    // adaptive triangulations are narrowed through the scratch on upload
+    VertexDataType index_type;
+    std::vector<std::uint16_t> narrowed_indices;
+
+    // Part of the element buffer after the levels that holds the adaptive
+    // triangulation, and its length while one is drawn
+    std::size_t adaptive_first;
+    std::size_t adaptive_count;
+
+    // Finished meshes are passed from the generation thread to the render
+    // thread without locking. Each side owns one buffer and the third sits
+    // in the mailbox, whose index is swapped atomically; fresh_mesh marks
+    // it as not yet drawn. A newer mesh simply replaces an unread one.
+    static constexpr unsigned int fresh_mesh = 4;
+    std::array<MeshUpdate, stream_regions> buffers;
+    std::atomic<unsigned int> mailbox;
+    unsigned int front;
+
+    // Regions of the vertex stream given up by the renderer that the GPU
+    // may still be reading, a bit each. The generation thread waits for
+    // its back buffer's to clear before writing it.
+    std::mutex region_mutex;
+    std::condition_variable region_freed;
+    unsigned int busy_regions;
+
+    // Origin and multi-draw runs of the mesh in the vertex buffer, set
+    // while the full resolution ring is drawn
+    glm::ivec2 front_origin;
+    int front_spacing;
+    bool ring_drawn;
+    std::vector<GLsizei> ring_counts;
+    std::vector<const void *> ring_offsets;
+
+    std::mutex request_mutex;
+    std::condition_variable request_ready;
+    GenerationSettings requested_settings;
+    std::atomic<std::uint64_t> latest_request;
+    bool has_request;
+    bool stopping;
+
+    std::mutex error_mutex;
+    std::exception_ptr generation_error;
+
+    // Octaves of the height map, used by the generation thread only
+    OctaveLayerCache layer_cache;
+
+    // Scratch of the generation thread's stages
+    ScratchArena scratch_arena;
+
+    // Adaptive triangulation of the full resolution mesh, used by the
+    // generation thread only
+    Rtin rtin;
+
+    std::thread generation_thread;
 };
\ No newline at end of file
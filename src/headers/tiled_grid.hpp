@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Square grid of samples stored tile by tile instead of row by row. A tile
+// is 2^TileBits samples on a side, so with floats the default 32 x 32 tile
+// is 4 KiB, a single page: a sample's neighbours lie in the same tile or at
+// most three others, where a row-major grid puts the rows above and below
+// grid size samples away. Tiles are laid out row-major, and samples within
+// a tile too. The tiles along the far edges are padded, which keeps an
+// index down to shifts and masks. With TileBits = 0 the grid is plain
+// row-major.
+template <typename T, unsigned int TileBits = 5>
+class TiledGrid {
+public:
+    static constexpr unsigned int tile_edge = 1u << TileBits;
+    static constexpr unsigned int tile_mask = tile_edge - 1;
+    // Samples in a 64 byte cache line
+    static constexpr unsigned int line_samples = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+
+    TiledGrid() : grid_size(0), tiles_across(0) {}
+
+    explicit TiledGrid(const unsigned int t_size)
+        : grid_size(t_size),
+          tiles_across((t_size + tile_mask) >> TileBits),
+          samples(storage_size(t_size))
+    {
+    }
+
+    // Samples stored for a size x size grid, padding included
+    static std::size_t storage_size(const unsigned int size) {
+        const std::size_t tiles = (size + tile_mask) >> TileBits;
+        return tiles * tiles << (2 * TileBits);
+    }
+
+    unsigned int size() const {
+        return grid_size;
+    }
+
+    // Storage offset of column x of row y
+    std::size_t index(const unsigned int x, const unsigned int y) const {
+        const auto tile = std::size_t(y >> TileBits) * tiles_across + (x >> TileBits);
+        return (tile << (2 * TileBits)) + ((y & tile_mask) << TileBits) + (x & tile_mask);
+    }
+
+    T& operator()(const unsigned int x, const unsigned int y) {
+        return samples[index(x, y)];
+    }
+
+    const T& operator()(const unsigned int x, const unsigned int y) const {
+        return samples[index(x, y)];
+    }
+
+    // Samples by storage offset, as given by index or for_each_run
+    T& operator[](const std::size_t i) {
+        return samples[i];
+    }
+
+    const T& operator[](const std::size_t i) const {
+        return samples[i];
+    }
+
+    // Walks count samples along row y, starting at column x and moving step
+    // columns at a time, wrapping around from the last column to the first.
+    // Calls run(i, offset, n) for every stretch of the walk within a tile, or
+    // within the row when the grid is row-major:
+    // sample i + j of the walk, for j < n, is stored at offset + j * step.
+    // Offsets are the same in every grid of the same size, so one walk can
+    // cover several grids.
+    template <typename F>
+    void for_each_run(unsigned int x, const unsigned int y, const unsigned int step, const unsigned int count, F&& run) const {
+        for (unsigned int i = 0; i < count;) {
+            const auto tile_end = TileBits == 0 ? grid_size : std::min((x | tile_mask) + 1, grid_size);
+            const auto n = std::min((tile_end - x + step - 1) / step, count - i);
+            run(i, index(x, y), n);
+            i += n;
+            x += n * step;
+            if (x >= grid_size) {
+                x %= grid_size;
+            }
+        }
+    }
+
+    // Prefetches the row of the tile distance tiles further along the row
+    // holding offset. A walk that steps over most samples reads only a line
+    // or two of each tile it crosses, a page apart, and hardware prefetchers
+    // don't follow it across pages, so it has to fetch ahead itself. Kept
+    // inline, as GCC drops calls to a function that only prefetches.
+    // Row-major walks have a constant stride the prefetchers do follow.
+    [[gnu::always_inline]] void prefetch_ahead(const std::size_t offset, const unsigned int distance) const {
+        if constexpr (TileBits == 0) {
+            return;
+        }
+        const auto row = (offset & ~std::size_t(tile_mask)) + (std::size_t(distance) << (2 * TileBits));
+        if (row >= samples.size()) {
+            return;
+        }
+        for (unsigned int i = 0; i < tile_edge; i += line_samples) {
+            __builtin_prefetch(&samples[row + i]);
+        }
+    }
+
+    // Row-major size x size samples in and out
+    void from_linear(const T* linear) {
+        for (unsigned int y = 0; y < grid_size; y++) {
+            const auto row = linear + std::size_t(y) * grid_size;
+            for_each_run(0, y, 1, grid_size, [&](unsigned int i, std::size_t offset, unsigned int n) {
+                std::copy(row + i, row + i + n, &samples[offset]);
+            });
+        }
+    }
+
+    void to_linear(T* linear) const {
+        for (unsigned int y = 0; y < grid_size; y++) {
+            const auto row = linear + std::size_t(y) * grid_size;
+            for_each_run(0, y, 1, grid_size, [&](unsigned int i, std::size_t offset, unsigned int n) {
+                std::copy(&samples[offset], &samples[offset] + n, row + i);
+            });
+        }
+    }
+
+private:
+    unsigned int grid_size;
+    unsigned int tiles_across;
+    std::vector<T> samples;
+};
+
+// Layout of the terrain's maps and octave layers. They are row-major: the
+// preview levels walk every few samples of a row, which reads a line or two
+// of each tile it crosses, and only the full resolution vertex pass gains
+// from tiles. TERRAIN_TILED_MAPS stores them in 32 x 32 tiles instead, for
+// terrain_bench_tiled to measure the two against each other.
+#ifdef TERRAIN_TILED_MAPS
+constexpr unsigned int map_tile_bits = 5;
+#else
+constexpr unsigned int map_tile_bits = 0;
+#endif
+
+using MapGrid = TiledGrid<float, map_tile_bits>;
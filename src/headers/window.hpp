@@ -154,7 +154,8 @@ enum class Capability {
     DEPTH_TEST = GL_DEPTH_TEST,
     SCISSOR_TEST = GL_SCISSOR_TEST,
     STENCIL_TEST = GL_STENCIL_TEST,
-    PROGRAM_POINT_SIZE = GL_PROGRAM_POINT_SIZE
+    PROGRAM_POINT_SIZE = GL_PROGRAM_POINT_SIZE,
+    PRIMITIVE_RESTART = GL_PRIMITIVE_RESTART
 };
 
 class Window {
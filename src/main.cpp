@@ -12,6 +12,7 @@
 #include "headers/window.hpp"
 
 #include "headers/cube.hpp"
+#include "headers/terrain_chunks.hpp"
 #include "headers/terrain_squares.hpp"
 
 // settings
@@ -20,13 +21,19 @@ constexpr auto WINDOW_HEIGHT = 900;
 
 constexpr auto GRID_SIZE = 150;
 
-auto camera_settings = CameraSettings(CameraDefault::ZOOM, WINDOW_WIDTH / WINDOW_HEIGHT, 0.1, 1000.0);
+// Streamed chunks reach kilometres away, so the far plane is well past the
+// fixed grid
+auto camera_settings = CameraSettings(CameraDefault::ZOOM, WINDOW_WIDTH / WINDOW_HEIGHT, 0.5, 16384.0);
 auto camera = Camera<Perspective>(camera_settings, glm::vec3(-50.0f, 60.0f, GRID_SIZE / 2.0f), glm::vec3(0.0, 1.0, 0.0), 0.0, -35.0);
 
 Window window(WINDOW_WIDTH, WINDOW_HEIGHT, "Terrain Generator");
 
 bool focus = true;
 
+// Arrow keys move the window over the terrain a whole sample at a time
+// instead of shifting the noise offset, so only the edges are regenerated
+bool pan_by_samples = false;
+
 GenerationSettings settings;
 
 // custom callback 
@@ -64,19 +71,35 @@ void process_input(float delta_time)
     }
 
     if(window.get_key(Key::KEY_LEFT) == KeyState::PRESSED) {
-        settings.offset.x -= 0.01;
+        if(pan_by_samples) {
+            settings.origin.x -= 1;
+        } else {
+            settings.offset.x -= 0.01;
+        }
     }
 
     if(window.get_key(Key::KEY_RIGHT) == KeyState::PRESSED) {
-        settings.offset.x += 0.01;
+        if(pan_by_samples) {
+            settings.origin.x += 1;
+        } else {
+            settings.offset.x += 0.01;
+        }
     }
 
     if(window.get_key(Key::KEY_UP) == KeyState::PRESSED) {
-        settings.offset.y += 0.01;
+        if(pan_by_samples) {
+            settings.origin.y += 1;
+        } else {
+            settings.offset.y += 0.01;
+        }
     }
 
     if(window.get_key(Key::KEY_DOWN) == KeyState::PRESSED) {
-        settings.offset.y -= 0.01;
+        if(pan_by_samples) {
+            settings.origin.y -= 1;
+        } else {
+            settings.offset.y -= 0.01;
+        }
     }
 
 }
@@ -115,14 +138,30 @@ int main() try {
     window.set_mouse_callback(process_mouse_button, process_mouse_movement);
     window.set_mouse_mode(MouseMode::DISABLED);
     window.enable_capability(Capability::DEPTH_TEST);
+    // The terrain draws its rows as strips ended by a restart index
+    window.enable_capability(Capability::PRIMITIVE_RESTART);
 
     auto mvm_shader = Shader::create<Shaders::Mvm>();
     auto terrain_shader = Shader::create<Shaders::Terrain>();
+    auto pulled_shader = Shader::create<Shaders::TerrainPulled>();
+    auto chunk_shader = Shader::create<Shaders::TerrainLod>();
+
+    // Vertices only keep their biome, which the shaders colour
+    const auto palette = Biomes::palette();
+    static_assert(Biomes::count <= 16, "The terrain shaders have room for 16 biome colours");
+    for(auto* biome_shader : { &terrain_shader, &pulled_shader, &chunk_shader }) {
+        biome_shader->use();
+        biome_shader->set_vec3_array("palette", palette.data(), palette.size());
+    }
 
     auto light = Cube::create();
     auto light_position = glm::vec3(GRID_SIZE / 2.0f, 100.0f, GRID_SIZE / 2.0f);
 
     auto terrain = TerrainSquares::create(GRID_SIZE);
+    auto chunks = TerrainChunks(
+        TerrainChunks::default_chunk_cells,
+        TerrainChunks::default_cpu_budget,
+        TerrainChunks::default_gpu_budget);
 
     auto delta_time = 0.0f;
     auto last_frame = 0.0f;
@@ -140,6 +179,12 @@ int main() try {
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     GenerationSettings last_settings;
+    int layer_cache_mib = int(TerrainSquares::default_layer_cache_budget >> 20);
+    bool stream_chunks = false;
+    bool height_texture = false;
+    int chunk_cpu_mib = int(TerrainChunks::default_cpu_budget >> 20);
+    int chunk_gpu_mib = int(TerrainChunks::default_gpu_budget >> 20);
+    float view_distance = 4096.0f;
 
     while (!window.should_close())
     {
@@ -171,13 +216,82 @@ int main() try {
         ImGui::SliderFloat("Lacunarity", &settings.lacunarity, 0.1f, 2.5f);
         ImGui::SliderFloat("X Offset", &settings.offset.x, -100.0f, 100.0f);
         ImGui::SliderFloat("Y Offset", &settings.offset.y, -100.0f, 100.0f);
+        ImGui::Checkbox("pan by samples", &pan_by_samples);
+        ImGui::SliderFloat("warp", &settings.warp_strength, 0.0f, 4.0f);
+        ImGui::SliderFloat("warp scale", &settings.warp_scale, 0.05f, 1.0f);
 
+        auto noise_type = static_cast<int>(settings.noise_type);
+        if(ImGui::Combo("noise", &noise_type, "Perlin 3D\0Perlin 2D\0Simplex 2D\0")) {
+            settings.noise_type = static_cast<NoiseType>(noise_type);
+        }
+
+        auto lattice_hash = static_cast<int>(settings.lattice_hash);
+        if(ImGui::Combo("lattice", &lattice_hash, "Permutation\0Seeded hash\0")) {
+            settings.lattice_hash = static_cast<LatticeHash>(lattice_hash);
+        }
+
+        auto height_range = static_cast<int>(settings.height_range);
+        if(ImGui::Combo("height range", &height_range, "Observed\0Analytic bound\0")) {
+            settings.height_range = static_cast<HeightRange>(height_range);
+        }
+        ImGui::SliderFloat("mesh error", &settings.mesh_error, 0.0f, 0.1f, "%.4f", 3.0f);
+
+        if(ImGui::SliderInt("layer cache MiB", &layer_cache_mib, 0, 1024)) {
+            terrain->set_layer_cache_budget(std::size_t(layer_cache_mib) << 20);
+        }
+
+        // The format is fixed when the terrain is created, so switching
+        // starts it over with the current settings
+        if(ImGui::Checkbox("height texture", &height_texture)) {
+            const auto format = height_texture ? SampleFormat::HEIGHT_TEXTURE : SampleFormat::VERTICES;
+            terrain = TerrainSquares::create(GRID_SIZE, GridIndices::default_options, format);
+            terrain->set_layer_cache_budget(std::size_t(layer_cache_mib) << 20);
+            last_settings = settings;
+            terrain->update(settings);
+        }
+
+        ImGui::Checkbox("stream chunks", &stream_chunks);
+        ImGui::SliderFloat("view distance", &view_distance, 256.0f, camera_settings.far);
+        const auto chunk_cpu_changed = ImGui::SliderInt("chunk memory MiB", &chunk_cpu_mib, 16, 2048);
+        const auto chunk_gpu_changed = ImGui::SliderInt("chunk video memory MiB", &chunk_gpu_mib, 16, 2048);
+        if(chunk_cpu_changed || chunk_gpu_changed) {
+            chunks.set_budgets(std::size_t(chunk_cpu_mib) << 20, std::size_t(chunk_gpu_mib) << 20);
+        }
+
+        ImGui::Text("Terrain: %llu triangles", static_cast<unsigned long long>(terrain->triangle_count()));
+        const auto layer_stats = terrain->layer_cache_stats();
+        ImGui::Text("Octave layers: %.0f%% hits (%llu/%llu), %.1f MiB",
+            100.0f * layer_stats.hit_rate(),
+            static_cast<unsigned long long>(layer_stats.hits),
+            static_cast<unsigned long long>(layer_stats.hits + layer_stats.misses),
+            layer_stats.bytes / float(1 << 20));
+        const auto scratch_stats = terrain->scratch_stats();
+        ImGui::Text("Scratch: %llu allocations, %.1f MiB",
+            static_cast<unsigned long long>(scratch_stats.allocations),
+            scratch_stats.bytes / float(1 << 20));
+        const auto chunk_stats = chunks.stats();
+        ImGui::Text("Chunks: %llu drawn of %llu (%.1f MiB), %llu cached (%.1f MiB), %llu queued",
+            static_cast<unsigned long long>(chunk_stats.drawn),
+            static_cast<unsigned long long>(chunk_stats.resident),
+            chunk_stats.gpu_bytes / float(1 << 20),
+            static_cast<unsigned long long>(chunk_stats.cached),
+            chunk_stats.cpu_bytes / float(1 << 20),
+            static_cast<unsigned long long>(chunk_stats.queued));
+        const auto cull_stats = chunks.cull_stats();
+        ImGui::Text("Culling: %llu tested, %llu outside the frustum, %llu occluded",
+            static_cast<unsigned long long>(cull_stats.tested),
+            static_cast<unsigned long long>(cull_stats.frustum_culled),
+            static_cast<unsigned long long>(cull_stats.occluded));
+        ImGui::Text("Noise kernels: %s", NoiseBatch::level_name(NoiseBatch::active_level()).data());
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
         ImGui::End();
 
         ImGui::Render();
 
-        if(!(settings == last_settings)) {
+        // The fixed grid is left as it was while chunks are streamed
+        if(stream_chunks) {
+            chunks.update(settings, camera.get_position(), view_distance);
+        } else if(!(settings == last_settings)) {
             last_settings = settings;
             terrain->update(settings);
         }
@@ -194,13 +308,24 @@ int main() try {
         mvm_shader.set_mat4("model", glm::translate(glm::mat4x4(1.0), light_position));
         light->draw();
         
-        terrain_shader.use();
-        terrain_shader.set_vec3("light_color", glm::vec3(1.0, 1.0, 1.0));
-        terrain_shader.set_vec3("light_pos", light_position);
-        terrain_shader.set_mat4("projection", projection);
-        terrain_shader.set_mat4("view", view);
-        terrain_shader.set_mat4("model", glm::translate(glm::mat4x4(1.0), glm::vec3(0.0f, -1.0f, 0.0f)));
-        terrain->draw();
+        auto& shader = stream_chunks ? chunk_shader : height_texture ? pulled_shader : terrain_shader;
+        shader.use();
+        shader.set_vec3("light_color", glm::vec3(1.0, 1.0, 1.0));
+        shader.set_vec3("light_pos", light_position);
+        shader.set_mat4("projection", projection);
+        shader.set_mat4("view", view);
+        shader.set_float("height_scale", settings.height_scale);
+        if(stream_chunks) {
+            const auto model = glm::translate(glm::mat4x4(1.0), glm::vec3(0.0f, -1.0f, 0.0f));
+            shader.set_mat4("model", model);
+            chunks.cull(model, view, projection, camera.get_position(), settings.height_scale);
+            chunks.draw(shader, camera.get_position());
+        } else {
+            terrain->prepare_draw(shader);
+            const auto origin = terrain->drawn_origin();
+            shader.set_mat4("model", glm::translate(glm::mat4x4(1.0), glm::vec3(-origin.y, -1.0f, -origin.x)));
+            terrain->draw();
+        }
 
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
@@ -0,0 +1,16 @@
+// Compiled with the matching -m flag (see CMakeLists.txt); the tables are only
+// handed out by NoiseBatch once the running CPU is known to support it.
+#include "headers/noise_graphs.hpp"
+#include "headers/noise_kernels.hpp"
+
+#if defined(__AVX2__)
+const NoiseKernelTable& avx2_noise_kernels() {
+    static const auto table = make_noise_kernel_table<Avx2Lanes>();
+    return table;
+}
+
+const NoiseGraphTable& avx2_noise_graphs() {
+    static const auto table = make_noise_graph_table<Avx2Lanes, NoiseGraphTable>();
+    return table;
+}
+#endif
@@ -0,0 +1,23 @@
+// Compiled with the matching -m flag (see CMakeLists.txt); the tables are only
+// handed out by NoiseBatch once the running CPU is known to support it.
+// GCC 12's avx512fintrin.h seeds its intrinsics with _mm512_undefined_*(),
+// which trips -W(maybe-)uninitialized once they are inlined into the kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "headers/noise_graphs.hpp"
+#include "headers/noise_kernels.hpp"
+
+#if defined(__AVX512F__)
+const NoiseKernelTable& avx512_noise_kernels() {
+    static const auto table = make_noise_kernel_table<Avx512Lanes>();
+    return table;
+}
+
+const NoiseGraphTable& avx512_noise_graphs() {
+    static const auto table = make_noise_graph_table<Avx512Lanes, NoiseGraphTable>();
+    return table;
+}
+#endif
@@ -0,0 +1,133 @@
+#include <atomic>
+
+#include "headers/noise_batch.hpp"
+#include "headers/noise_graphs.hpp"
+#include "headers/noise_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NOISE_X86_KERNELS 1
+#else
+#define NOISE_X86_KERNELS 0
+#endif
+
+const NoiseKernelTable& scalar_noise_kernels() {
+    static const auto table = make_noise_kernel_table<ScalarLanes>();
+    return table;
+}
+
+const NoiseGraphTable& scalar_noise_graphs() {
+    static const auto table = make_noise_graph_table<ScalarLanes, NoiseGraphTable>();
+    return table;
+}
+
+namespace {
+    const NoiseKernelTable& kernels_for(SimdLevel level) {
+        switch(level) {
+#if NOISE_X86_KERNELS
+            case SimdLevel::AVX512:
+                return avx512_noise_kernels();
+            case SimdLevel::AVX2:
+                return avx2_noise_kernels();
+            case SimdLevel::SSE42:
+                return sse42_noise_kernels();
+#endif
+            default:
+                return scalar_noise_kernels();
+        }
+    }
+
+    const NoiseGraphTable& graphs_for(SimdLevel level) {
+        switch(level) {
+#if NOISE_X86_KERNELS
+            case SimdLevel::AVX512:
+                return avx512_noise_graphs();
+            case SimdLevel::AVX2:
+                return avx2_noise_graphs();
+            case SimdLevel::SSE42:
+                return sse42_noise_graphs();
+#endif
+            default:
+                return scalar_noise_graphs();
+        }
+    }
+
+    std::atomic<SimdLevel>& current_level() {
+        static std::atomic<SimdLevel> level(NoiseBatch::detected_level());
+        return level;
+    }
+
+    const NoiseKernelSet& active_kernels(LatticeHash hash) {
+        const auto& table = kernels_for(current_level().load(std::memory_order_relaxed));
+        return hash == LatticeHash::SEEDED ? table.seeded : table.permutation;
+    }
+}
+
+const NoiseGraphTable& active_noise_graphs() {
+    return graphs_for(current_level().load(std::memory_order_relaxed));
+}
+
+SimdLevel NoiseBatch::detected_level() {
+#if NOISE_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    if(__builtin_cpu_supports("sse4.2")) {
+        return SimdLevel::SSE42;
+    }
+#endif
+    return SimdLevel::SCALAR;
+}
+
+SimdLevel NoiseBatch::active_level() {
+    return current_level().load(std::memory_order_relaxed);
+}
+
+void NoiseBatch::set_level(SimdLevel level) {
+    const auto detected = detected_level();
+    current_level().store(level > detected ? detected : level, std::memory_order_relaxed);
+}
+
+std::string_view NoiseBatch::level_name(SimdLevel level) {
+    switch(level) {
+        case SimdLevel::AVX512:
+            return "AVX-512";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::SSE42:
+            return "SSE4.2";
+        default:
+            return "Scalar";
+    }
+}
+
+void NoiseBatch::perlin3(const float* x, const float* y, const float* z, float* out, std::size_t count, LatticeHash hash, std::int32_t seed) {
+    active_kernels(hash).perlin3(x, y, z, out, nullptr, nullptr, nullptr, count, seed);
+}
+
+void NoiseBatch::perlin2(const float* x, const float* y, float* out, std::size_t count, LatticeHash hash, std::int32_t seed) {
+    active_kernels(hash).perlin2(x, y, out, nullptr, nullptr, count, seed);
+}
+
+void NoiseBatch::simplex2(const float* x, const float* y, float* out, std::size_t count, LatticeHash hash, std::int32_t seed) {
+    active_kernels(hash).simplex2(x, y, out, nullptr, nullptr, count, seed);
+}
+
+void NoiseBatch::perlin3_gradient(const float* x, const float* y, const float* z, float* out, float* out_dx, float* out_dy, float* out_dz, std::size_t count, LatticeHash hash, std::int32_t seed) {
+    active_kernels(hash).perlin3_gradient(x, y, z, out, out_dx, out_dy, out_dz, count, seed);
+}
+
+void NoiseBatch::perlin2_gradient(const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, LatticeHash hash, std::int32_t seed) {
+    active_kernels(hash).perlin2_gradient(x, y, out, out_dx, out_dy, count, seed);
+}
+
+void NoiseBatch::simplex2_gradient(const float* x, const float* y, float* out, float* out_dx, float* out_dy, std::size_t count, LatticeHash hash, std::int32_t seed) {
+    active_kernels(hash).simplex2_gradient(x, y, out, out_dx, out_dy, count, seed);
+}
+
+void NoiseBatch::perlin2_channels(const float* x, const float* y, float* const* out, std::size_t channels, std::size_t count, LatticeHash hash, std::int32_t seed) {
+    active_kernels(hash).perlin2_channels(x, y, out, channels, count, seed);
+}
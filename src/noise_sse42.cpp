@@ -0,0 +1,16 @@
+// Compiled with the matching -m flag (see CMakeLists.txt); the tables are only
+// handed out by NoiseBatch once the running CPU is known to support it.
+#include "headers/noise_graphs.hpp"
+#include "headers/noise_kernels.hpp"
+
+#if defined(__SSE4_2__)
+const NoiseKernelTable& sse42_noise_kernels() {
+    static const auto table = make_noise_kernel_table<Sse42Lanes>();
+    return table;
+}
+
+const NoiseGraphTable& sse42_noise_graphs() {
+    static const auto table = make_noise_graph_table<Sse42Lanes, NoiseGraphTable>();
+    return table;
+}
+#endif
@@ -0,0 +1,103 @@
+#include "headers/octave_layer_cache.hpp"
+
+#include <algorithm>
+
+OctaveLayerCache::OctaveLayerCache(std::size_t t_budget)
+    : pass(0),
+      budget(t_budget),
+      bytes(0),
+      hits(0),
+      misses(0)
+{
+}
+
+void OctaveLayerCache::begin_pass() {
+    pass++;
+    while(bytes.load() > budget.load() && evict_one()) {
+    }
+}
+
+OctaveLayer* OctaveLayerCache::acquire(const OctaveLayerKey& key, unsigned int stride) {
+    for(auto& layer : layers) {
+        if(layer->key == key) {
+            layer->last_used = pass;
+            if(layer->stride != 0 && layer->stride <= stride) {
+                hits++;
+            } else {
+                misses++;
+            }
+            return layer.get();
+        }
+    }
+
+    misses++;
+
+    // Evicted layers of the same size are reused, so a full cache doesn't
+    // keep allocating and faulting in fresh memory
+    const auto size = layer_bytes(key.grid_size);
+    std::unique_ptr<OctaveLayer> recycled;
+    while(bytes.load() + size > budget.load()) {
+        auto evicted = evict_one();
+        if(!evicted) {
+            return nullptr;
+        }
+        if(evicted->key.grid_size == key.grid_size) {
+            recycled = std::move(evicted);
+        }
+    }
+
+    if(recycled) {
+        recycled->key = key;
+        recycled->stride = 0;
+        recycled->last_used = pass;
+        layers.push_back(std::move(recycled));
+    } else {
+        layers.push_back(std::make_unique<OctaveLayer>(OctaveLayer {
+            key,
+            MapGrid(key.grid_size),
+            MapGrid(key.grid_size),
+            MapGrid(key.grid_size),
+            0,
+            pass
+        }));
+    }
+    bytes += size;
+
+    return layers.back().get();
+}
+
+void OctaveLayerCache::clear() {
+    layers.clear();
+    bytes = 0;
+}
+
+void OctaveLayerCache::set_budget(std::size_t t_budget) {
+    budget = t_budget;
+}
+
+OctaveLayerStats OctaveLayerCache::stats() const {
+    return OctaveLayerStats { hits.load(), misses.load(), bytes.load(), budget.load() };
+}
+
+std::size_t OctaveLayerCache::layer_bytes(unsigned int grid_size) {
+    return MapGrid::storage_size(grid_size) * 3 * sizeof(float);
+}
+
+std::unique_ptr<OctaveLayer> OctaveLayerCache::evict_one() {
+    auto oldest = layers.end();
+    for(auto layer = layers.begin(); layer != layers.end(); layer++) {
+        if((*layer)->last_used < pass && (oldest == layers.end() || (*layer)->last_used < (*oldest)->last_used)) {
+            oldest = layer;
+        }
+    }
+
+    if(oldest == layers.end()) {
+        return nullptr;
+    }
+
+    auto evicted = std::move(*oldest);
+    layers.erase(oldest);
+    bytes -= layer_bytes(evicted->key.grid_size);
+
+    return evicted;
+}
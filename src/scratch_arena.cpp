@@ -0,0 +1,73 @@
+#include "headers/scratch_arena.hpp"
+
+#include "headers/task_scheduler.hpp"
+
+ScratchArena::ScratchArena()
+    : stacks(TaskScheduler::instance().thread_count()),
+      allocations(0),
+      bytes(0)
+{
+}
+
+ScratchStats ScratchArena::stats() const {
+    return ScratchStats { allocations.load(), bytes.load() };
+}
+
+ScratchArena::Stack& ScratchArena::local_stack() {
+    return stacks[TaskScheduler::instance().thread_index()];
+}
+
+void* ScratchArena::take(Stack& stack, std::size_t size, std::size_t alignment) {
+    // Later chunks are always bigger, so the first one the request fits in
+    // is taken and the tail of the chunks before it is left unused
+    while (stack.chunk < stack.chunks.size()) {
+        const auto& chunk = stack.chunks[stack.chunk];
+        const auto offset = (stack.used + alignment - 1) / alignment * alignment;
+        if (offset + size <= chunk.size) {
+            stack.used = offset + size;
+            return chunk.memory.get() + offset;
+        }
+        stack.chunk++;
+        stack.used = 0;
+    }
+
+    const auto last_size = stack.chunks.empty() ? 0 : stack.chunks.back().size;
+    add_chunk(stack, std::max({ size + alignment, last_size * 2, min_chunk_size }));
+    return take(stack, size, alignment);
+}
+
+void ScratchArena::release(Stack& stack, std::size_t chunk, std::size_t used) {
+    stack.chunk = chunk;
+    stack.used = used;
+
+    // The outermost frame merges the chunks, so the next generation finds
+    // all the memory it needs in the first one
+    if (--stack.frames == 0 && stack.chunks.size() > 1) {
+        std::size_t total = 0;
+        for (const auto& existing : stack.chunks) {
+            total += existing.size;
+            bytes -= existing.size;
+        }
+        stack.chunks.clear();
+        add_chunk(stack, total);
+    }
+}
+
+void ScratchArena::add_chunk(Stack& stack, std::size_t size) {
+    stack.chunks.push_back(Chunk { std::make_unique<std::byte[]>(size), size });
+    allocations++;
+    bytes += size;
+}
+
+ScratchFrame::ScratchFrame(ScratchArena& t_arena)
+    : arena(t_arena),
+      stack(t_arena.local_stack()),
+      chunk(stack.chunk),
+      used(stack.used)
+{
+    stack.frames++;
+}
+
+ScratchFrame::~ScratchFrame() {
+    arena.release(stack, chunk, used);
+}
@@ -130,6 +130,22 @@ void Shader::set_vec2(const char *name, const glm::vec2 &value) const
     glUniform2fv(variable, 1, &value[0]); 
 }
 
+void Shader::set_ivec2(const char *name, const glm::ivec2 &value) const
+{ 
+    auto variable = glGetUniformLocation(m_program, name);
+
+#ifdef __DEBUG__
+    if(variable == -1) {
+        std::stringstream error;
+        error << "Unknown_variable: ";
+        error << name;
+        throw std::runtime_error(error.str().c_str());
+    }
+#endif
+
+    glUniform2iv(variable, 1, &value[0]); 
+}
+
 void Shader::set_vec3(const char *name, const glm::vec3 &value) const
 { 
     auto variable = glGetUniformLocation(m_program, name);
@@ -146,6 +162,22 @@ void Shader::set_vec3(const char *name, const glm::vec3 &value) const
     glUniform3fv(variable, 1, &value[0]); 
 }
 
+void Shader::set_vec3_array(const char *name, const glm::vec3 *values, std::size_t count) const
+{ 
+    auto variable = glGetUniformLocation(m_program, name);
+
+#ifdef __DEBUG__
+    if(variable == -1) {
+        std::stringstream error;
+        error << "Unknown_variable: ";
+        error << name;
+        throw std::runtime_error(error.str().c_str());
+    }
+#endif
+
+    glUniform3fv(variable, static_cast<GLsizei>(count), &values[0][0]); 
+}
+
 void Shader::set_vec4(const char *name, const glm::vec4 &value) const
 { 
     auto variable = glGetUniformLocation(m_program, name);
@@ -9,9 +9,9 @@ static constexpr std::string_view TerrainVert = R"(
     // Model view matrix vertex shader
 
     #version 330 core
-    layout (location = 0) in vec3 a_pos;
-    layout (location = 1) in vec3 a_normal;
-    layout (location = 2) in vec3 a_color;
+    layout (location = 0) in float a_height;
+    layout (location = 1) in vec2 a_normal;
+    layout (location = 2) in uint a_material;
     //layout (location = 2) in vec2 a_tex_coord;
 
     out vec3 fragment_pos;
@@ -22,14 +22,46 @@ static constexpr std::string_view TerrainVert = R"(
     uniform mat4 model;
     uniform mat4 view;
     uniform mat4 projection;
+    uniform float height_scale;
+
+    // The mesh is mesh_size vertices a side, laid out row by row but for
+    // the full resolution ring, whose rows and columns start ring_offset
+    // in. Its first vertex lies at mesh_corner and the rest mesh_spacing
+    // apart.
+    uniform int mesh_size;
+    uniform ivec2 ring_offset;
+    uniform vec2 mesh_corner;
+    uniform float mesh_spacing;
+
+    // Colour of every biome
+    uniform vec3 palette[16];
+
+    // Unfolds a normal packed onto the octahedron |x| + |y| + |z| = 1
+    vec3 unpack_normal(vec2 folded)
+    {
+        vec3 normal = vec3(folded.x, 1.0 - abs(folded.x) - abs(folded.y), folded.y);
+        float below = max(-normal.y, 0.0);
+        normal.x += normal.x >= 0.0 ? -below : below;
+        normal.z += normal.z >= 0.0 ? -below : below;
+        return normalize(normal);
+    }
 
     void main()
     {
-        fragment_pos = vec3(model * vec4(a_pos, 1.0));
-        surface_normal = mat3(transpose(inverse(model))) * a_normal;
-        fragment_color = a_color;
+        ivec2 sample_index = (ivec2(gl_VertexID / mesh_size, gl_VertexID % mesh_size) - ring_offset + mesh_size) % mesh_size;
+        vec2 ground = mesh_corner + vec2(sample_index) * mesh_spacing;
+        vec3 unit_normal = unpack_normal(a_normal);
+
+        // The mesh is generated for a height scale of 1. Stretching it
+        // vertically scales the normal's horizontal components instead.
+        vec3 position = vec3(ground.x, a_height * height_scale, ground.y);
+        vec3 normal = vec3(unit_normal.x * height_scale, unit_normal.y, unit_normal.z * height_scale);
+
+        fragment_pos = vec3(model * vec4(position, 1.0));
+        surface_normal = mat3(transpose(inverse(model))) * normal;
+        fragment_color = palette[a_material];
         //tex_coord = a_tex_coord;
 
-        gl_Position = projection * view * model * vec4(a_pos, 1.0f);
+        gl_Position = projection * view * model * vec4(position, 1.0f);
     }
 )";
@@ -0,0 +1,80 @@
+// Shader adapted from the following tutorials:
+// https://learnopengl.com/Lighting/Basic-Lighting
+
+#pragma once
+
+#include <string_view>
+
+static constexpr std::string_view TerrainLodVert = R"(
+    // Streamed chunk vertex shader, blending each chunk into the next
+    // coarser level of detail as it gets further away
+
+    #version 330 core
+    layout (location = 0) in float a_height;
+    layout (location = 1) in vec2 a_normal;
+    layout (location = 2) in uint a_material;
+    layout (location = 3) in float a_target_height;
+    layout (location = 4) in vec2 a_target_normal;
+    layout (location = 5) in uint a_target_material;
+
+    out vec3 fragment_pos;
+    out vec3 surface_normal;
+    out vec3 fragment_color;
+
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform float height_scale;
+
+    // Cells between the chunk's samples, and the ground distances over
+    // which it turns into the coarser level
+    uniform float spacing;
+    uniform vec2 morph_range;
+    uniform vec3 camera_position;
+
+    // The chunk is chunk_size vertices a side, laid out row by row from
+    // chunk_corner
+    uniform int chunk_size;
+    uniform vec2 chunk_corner;
+
+    // Colour of every biome
+    uniform vec3 palette[16];
+
+    // Unfolds a normal packed onto the octahedron |x| + |y| + |z| = 1
+    vec3 unpack_normal(vec2 folded)
+    {
+        vec3 normal = vec3(folded.x, 1.0 - abs(folded.x) - abs(folded.y), folded.y);
+        float below = max(-normal.y, 0.0);
+        normal.x += normal.x >= 0.0 ? -below : below;
+        normal.z += normal.z >= 0.0 ? -below : below;
+        return normalize(normal);
+    }
+
+    void main()
+    {
+        ivec2 sample_index = ivec2(gl_VertexID / chunk_size, gl_VertexID % chunk_size);
+        vec2 sample_ground = chunk_corner + vec2(sample_index) * spacing;
+
+        // Distance along the ground, as the chunks are chosen by
+        float distance = length(sample_ground - camera_position.xz);
+        float morph = clamp((distance - morph_range.x) / (morph_range.y - morph_range.x), 0.0, 1.0);
+
+        // Vertices at odd samples slide onto the even one before them, so
+        // fully blended the grid is the coarser level's
+        vec2 odd = vec2(sample_index & 1);
+        vec2 ground = sample_ground - odd * spacing * morph;
+        float height = mix(a_height, a_target_height, morph);
+        vec3 blended_normal = mix(unpack_normal(a_normal), unpack_normal(a_target_normal), morph);
+
+        // The mesh is generated for a height scale of 1. Stretching it
+        // vertically scales the normal's horizontal components instead.
+        vec3 position = vec3(ground.x, height * height_scale, ground.y);
+        vec3 normal = vec3(blended_normal.x * height_scale, blended_normal.y, blended_normal.z * height_scale);
+
+        fragment_pos = vec3(model * vec4(position, 1.0));
+        surface_normal = mat3(transpose(inverse(model))) * normal;
+        fragment_color = mix(palette[a_material], palette[a_target_material], morph);
+
+        gl_Position = projection * view * model * vec4(position, 1.0f);
+    }
+)";
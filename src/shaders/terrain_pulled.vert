@@ -0,0 +1,87 @@
+// Shader adapted from the following tutorials:
+// https://learnopengl.com/Lighting/Basic-Lighting
+
+#pragma once
+
+#include <string_view>
+
+static constexpr std::string_view TerrainPulledVert = R"(
+    // Model view matrix vertex shader pulling its vertices from a height
+    // texture instead of attributes
+
+    #version 330 core
+
+    out vec3 fragment_pos;
+    out vec3 surface_normal;
+    out vec3 fragment_color;
+
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform float height_scale;
+
+    // Laid out as for the terrain shader
+    uniform int mesh_size;
+    uniform ivec2 ring_offset;
+    uniform vec2 mesh_corner;
+    uniform float mesh_spacing;
+
+    // Texel x, y holds vertex y * mesh_size + x: its height as a 16 bit
+    // fraction split low byte first, its temperature and its moisture
+    uniform usampler2D samples;
+
+    // Biome of every cell of height, temperature and moisture
+    uniform usampler3D biomes;
+    uniform vec3 palette[16];
+
+    // Heights at or below it are flat water
+    uniform float water_level;
+
+    // Height, temperature and moisture of a sample of the window, clamped
+    // to its edges
+    vec3 fetch_sample(ivec2 sample_index)
+    {
+        ivec2 stored = (clamp(sample_index, ivec2(0), ivec2(mesh_size - 1)) + ring_offset) % mesh_size;
+        uvec4 texel = texelFetch(samples, stored.yx, 0);
+        return vec3(float(texel.r | (texel.g << 8u)) / 65535.0, vec2(texel.ba) / 255.0);
+    }
+
+    float surface_height(ivec2 sample_index)
+    {
+        return max(fetch_sample(sample_index).x, water_level);
+    }
+
+    void main()
+    {
+        ivec2 sample_index = (ivec2(gl_VertexID / mesh_size, gl_VertexID % mesh_size) - ring_offset + mesh_size) % mesh_size;
+        vec2 ground = mesh_corner + vec2(sample_index) * mesh_spacing;
+        vec3 centre = fetch_sample(sample_index);
+        float height = max(centre.x, water_level);
+
+        // Central differences, one sided along the window's edges
+        ivec2 low = max(sample_index - 1, ivec2(0));
+        ivec2 high = min(sample_index + 1, ivec2(mesh_size - 1));
+        vec2 run = vec2(max(high - low, ivec2(1))) * mesh_spacing;
+        float slope_x = (surface_height(ivec2(high.x, sample_index.y)) - surface_height(ivec2(low.x, sample_index.y))) / run.x;
+        float slope_z = (surface_height(ivec2(sample_index.x, high.y)) - surface_height(ivec2(sample_index.x, low.y))) / run.y;
+        vec3 unit_normal = centre.x > water_level ? normalize(vec3(-slope_x, 1.0, -slope_z)) : vec3(0.0, 1.0, 0.0);
+
+        // The heights are for a height scale of 1. Stretching them
+        // vertically scales the normal's horizontal components instead.
+        vec3 position = vec3(ground.x, height * height_scale, ground.y);
+        vec3 normal = vec3(unit_normal.x * height_scale, unit_normal.y, unit_normal.z * height_scale);
+
+        // Like the generated vertices, take the biome of the second
+        // triangle of the vertex's cell, at its centroid
+        vec3 centroid = (centre + fetch_sample(sample_index + ivec2(0, 1)) + fetch_sample(sample_index + ivec2(1, 1))) / 3.0;
+        int cells = textureSize(biomes, 0).x;
+        ivec3 cell = min(ivec3(centroid * float(cells)), ivec3(cells - 1));
+        uint biome = texelFetch(biomes, cell, 0).r;
+
+        fragment_pos = vec3(model * vec4(position, 1.0));
+        surface_normal = mat3(transpose(inverse(model))) * normal;
+        fragment_color = palette[biome];
+
+        gl_Position = projection * view * model * vec4(position, 1.0f);
+    }
+)";
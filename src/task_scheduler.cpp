@@ -0,0 +1,212 @@
+#include "headers/task_scheduler.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Identifies the worker (and scheduler) running on this thread
+    thread_local const TaskScheduler* worker_scheduler = nullptr;
+    thread_local std::size_t worker_queue = 0;
+}
+
+TaskScheduler& TaskScheduler::instance() {
+    static TaskScheduler scheduler(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return scheduler;
+}
+
+TaskScheduler::TaskScheduler(unsigned int t_workers)
+    : queued(0),
+      stopping(false)
+{
+    for(unsigned int i = 0; i < t_workers + 1; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    for(unsigned int i = 0; i < t_workers; i++) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(auto& worker : workers) {
+        worker.join();
+    }
+}
+
+std::size_t TaskScheduler::current_queue() const {
+    return worker_scheduler == this ? worker_queue : queues.size() - 1;
+}
+
+void TaskScheduler::run(std::size_t count, const void* body, Invoke invoke) {
+    Batch batch;
+    batch.body = body;
+    batch.invoke = invoke;
+    batch.remaining = count;
+    batch.queued = count;
+
+    // Outside threads deal contiguous runs of tasks to every worker so each
+    // starts on neighbouring tiles; a worker keeps nested tasks to itself
+    // and lets the others steal them
+    const auto own_queue = current_queue();
+    const auto external = own_queue == queues.size() - 1;
+    const auto targets = external ? workers.size() : 1;
+    batch.external = external;
+
+    // Counted before they are pushed so find_task never sees more tasks
+    // than queued
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued += count;
+    }
+
+    for(std::size_t target = 0; target < targets; target++) {
+        const auto begin = count * target / targets;
+        const auto end = count * (target + 1) / targets;
+        auto& queue = *queues[external ? target : own_queue];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for(auto i = begin; i < end; i++) {
+            queue.push_back(Task { &batch, i });
+        }
+    }
+
+    wake.notify_all();
+
+    // Help out until every task of this batch has run. Outside threads all
+    // share the last queue and the last scratch stacks, so they only run
+    // tasks of their own batch, never those of another outside thread.
+    //
+    // Other work doesn't concern them, and their tasks may sit behind it
+    // where they can't be taken, so rather than waking for any queued work
+    // they sleep until one of their tasks is taken or the batch finishes.
+    Task task;
+    while(batch.remaining.load() > 0) {
+        const auto untaken = batch.queued.load();
+        if(find_task(own_queue, task, external ? &batch : nullptr)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        if(external) {
+            finished.wait(lock, [&] { return batch.remaining.load() == 0 || batch.queued.load() != untaken; });
+        } else {
+            finished.wait(lock, [&] { return batch.remaining.load() == 0 || queued.load() > 0; });
+        }
+    }
+
+    if(batch.error) {
+        std::rethrow_exception(batch.error);
+    }
+}
+
+void TaskScheduler::worker_loop(std::size_t queue) {
+    worker_scheduler = this;
+    worker_queue = queue;
+
+    Task task;
+    while(true) {
+        if(find_task(queue, task, nullptr)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [&] { return stopping || queued.load() > 0; });
+        if(stopping) {
+            return;
+        }
+    }
+}
+
+bool TaskScheduler::find_task(std::size_t queue, Task& task, const Batch* only) {
+    if(queued.load() == 0) {
+        return false;
+    }
+
+    for(std::size_t offset = 0; offset < queues.size(); offset++) {
+        const auto victim = (queue + offset) % queues.size();
+        auto& tasks = *queues[victim];
+
+        {
+            std::lock_guard<std::mutex> lock(tasks.mutex);
+            if(tasks.size == 0 || (only && (offset == 0 ? tasks.back() : tasks.front()).batch != only)) {
+                continue;
+            }
+
+            task = offset == 0 ? tasks.pop_back() : tasks.pop_front();
+            queued--;
+            task.batch->queued--;
+        }
+
+        // The outside thread waiting on the batch may be able to take the
+        // tasks that were queued behind this one
+        if(task.batch->external) {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            finished.notify_all();
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void TaskScheduler::execute(const Task& task) {
+    auto& batch = *task.batch;
+
+    try {
+        batch.invoke(batch.body, task.index);
+    } catch(...) {
+        std::lock_guard<std::mutex> lock(batch.error_mutex);
+        if(!batch.error) {
+            batch.error = std::current_exception();
+        }
+    }
+
+    // The last task wakes whoever is waiting on the batch. Taking the lock
+    // keeps the wakeup from slipping in between their check and their wait.
+    if(--batch.remaining == 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        finished.notify_all();
+    }
+}
+
+void TaskScheduler::Queue::push_back(const Task& task) {
+    if(size == tasks.size()) {
+        // Unwrap into a buffer twice the size
+        std::vector<Task> grown(std::max<std::size_t>(tasks.size() * 2, 64));
+        for(std::size_t i = 0; i < size; i++) {
+            grown[i] = tasks[(head + i) % tasks.size()];
+        }
+        tasks = std::move(grown);
+        head = 0;
+    }
+
+    tasks[(head + size) % tasks.size()] = task;
+    size++;
+}
+
+const TaskScheduler::Task& TaskScheduler::Queue::front() const {
+    return tasks[head];
+}
+
+const TaskScheduler::Task& TaskScheduler::Queue::back() const {
+    return tasks[(head + size - 1) % tasks.size()];
+}
+
+TaskScheduler::Task TaskScheduler::Queue::pop_back() {
+    size--;
+    return tasks[(head + size) % tasks.size()];
+}
+
+TaskScheduler::Task TaskScheduler::Queue::pop_front() {
+    const auto task = tasks[head];
+    head = (head + 1) % tasks.size();
+    size--;
+    return task;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 
+#include "headers/drawable.hpp"
 #include "headers/window.hpp"
 
 // Default callback will just resize the OpenGL viewport
@@ -49,6 +50,9 @@ Window::Window(const unsigned int width, const unsigned int height, const char *
         throw std::runtime_error("Failed to initialize GLAD");
     }  
 
+    // Persistently mapped buffers, where the context goes past 3.3
+    load_buffer_storage(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+
     m_window = window;
 }
 